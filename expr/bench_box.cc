@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <vector>
+
+#include <fmt/format.h>
+#include <opencv2/imgproc.hpp>
+
+#include "bench_common.h"
+#include "config.hpp"
+#include "depth_rays.h"
+#include "height_map.h"
+#include "oriented_box.h"
+
+// Footprint measurement of detector::calcBiggestComponent before and
+// after BoxMeasurer, on whole recorded frames fused into one cloud.
+// The old path copies every point into a Point2f vector for
+// cv::minAreaRect and scans for the highest point. The new one reads
+// the clouds once, its stats come from clustering in the application and
+// are timed separately here. The height map pass for volume and
+// footprint follows the box, with the floor at the lowest point.
+
+int
+main(int argc, char **argv)
+{
+  constexpr int iterations = 50;
+  std::vector<const char *> paths(argv + 1, argv + argc);
+  if (paths.empty())
+    paths = { "media/depth_raw0", "media/depth_raw1" };
+
+  auto params = media_ir_params();
+
+  farsight::DepthRays rays;
+  rays.rebuild(params, depth_width, depth_height);
+
+  std::vector<farsight::PointCloud> clouds(paths.size());
+  for (size_t k = 0; k < paths.size(); ++k)
+  {
+    auto depth = load_frame(paths[k]);
+    rays.project(
+      depth.data(), 0, 0, depth_width, depth_height, clouds[k], 4.5f);
+  }
+
+  cv::RotatedRect rect;
+  float top = 0;
+  double old_ms = time_ms(iterations, [&] {
+    std::vector<cv::Point2f> points;
+    top = -INFINITY;
+    for (const auto &cloud : clouds)
+    {
+      cloud.for_each_valid([&](size_t i) {
+        points.emplace_back(cloud.x[i] * 1000, cloud.z[i] * 1000);
+        top = std::max(top, cloud.y[i]);
+      });
+    }
+    rect = cv::minAreaRect(points);
+  });
+
+  farsight::ClusterStats stats;
+  double stats_ms = time_ms(iterations, [&] {
+    stats = {};
+    for (const auto &cloud : clouds)
+    {
+      cloud.for_each_valid([&](size_t i) {
+        stats.add(cloud.x[i], cloud.y[i], cloud.z[i]);
+      });
+    }
+  });
+
+  farsight::OrientedBox box;
+  double new_ms = time_ms(iterations, [&] {
+    farsight::BoxMeasurer measurer(stats, { 0, 1, 0 });
+    for (const auto &cloud : clouds)
+      measurer.add(cloud);
+    box = measurer.result();
+  });
+
+  farsight::HeightMapStats volume;
+  const float floor_y = box.center.y - box.extents.z / 2;
+  double volume_ms = time_ms(iterations, [&] {
+    farsight::HeightMap heights(box, floor_y, 0.01f);
+    for (const auto &cloud : clouds)
+      heights.add(cloud);
+    volume = heights.result();
+  });
+
+  fmt::print("{} points in {} clouds\n", box.count, clouds.size());
+  fmt::print("minAreaRect: {:8.3f} ms, {:.1f} x {:.1f} mm, top {:.1f} mm\n",
+             old_ms,
+             std::max(rect.size.width, rect.size.height),
+             std::min(rect.size.width, rect.size.height),
+             top * 1000);
+  fmt::print("box:         {:8.3f} ms, {:.1f} x {:.1f} mm, top {:.1f} mm, "
+             "speedup {:.1f}x\n",
+             new_ms,
+             box.extents.x * 1000,
+             box.extents.y * 1000,
+             (box.center.y + box.extents.z / 2) * 1000,
+             old_ms / new_ms);
+  fmt::print("residuals:   {:.1f} {:.1f} {:.1f} mm\n",
+             box.residuals.x * 1000,
+             box.residuals.y * 1000,
+             box.residuals.z * 1000);
+  fmt::print("height map:  {:8.3f} ms, {:.1f} l, footprint {:.1f} cm2\n",
+             volume_ms,
+             volume.volume * 1000,
+             volume.footprint * 10000);
+  fmt::print("stats pass:  {:8.3f} ms, done by clustering otherwise\n",
+             stats_ms);
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "bench_common.h"
+#include "config.hpp"
+#include "depth_rays.h"
+#include "disjoint_set.h"
+
+// Exhaustive against spatial hash neighbour search of DisjointSet on a
+// box of a recorded frame. Labels may differ between the modes, the
+// partitions may not.
+// Organized clustering only joins neighbouring pixels, it is timed too,
+// single threaded and in tiles over the worker pool.
+
+farsight::Context3D farsight::context3D;
+
+static double
+cluster(DisjointSet &set,
+        DisjointSet::SearchMode mode,
+        const farsight::PointCloud &cloud)
+{
+  auto start = std::chrono::steady_clock::now();
+  set.reset();
+  set.setSearchMode(mode);
+  set.addPoints(cloud);
+  auto stop = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+// Both sets were filled with the same points in the same order
+static bool
+same_partition(const DisjointSet &a, const DisjointSet &b)
+{
+  std::unordered_map<size_t, size_t> a2b, b2a;
+
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    auto la = a.pointLabel(i), lb = b.pointLabel(i);
+    if (a2b.try_emplace(la, lb).first->second != lb ||
+        b2a.try_emplace(lb, la).first->second != la)
+      return false;
+  }
+
+  return a.size() == b.size();
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *path = argc > 1 ? argv[1] : "media/depth_raw0";
+  size_t box = argc > 2 ? std::stoul(argv[2]) : 150;
+
+  auto depth = load_frame(path);
+
+  auto params = media_ir_params();
+
+  farsight::DepthRays rays;
+  rays.rebuild(params, depth_width, depth_height);
+
+  box = std::min({ box, depth_width, depth_height });
+  farsight::PointCloud cloud;
+  rays.project(depth.data(),
+               (depth_width - box) / 2,
+               (depth_height - box) / 2,
+               box,
+               box,
+               cloud,
+               4.5f);
+
+  DisjointSet exhaustive, hashed;
+  auto slow = cluster(exhaustive, DisjointSet::SearchMode::EXHAUSTIVE, cloud);
+  auto fast = cluster(hashed, DisjointSet::SearchMode::SPATIAL_HASH, cloud);
+
+  auto sizes = hashed.countCategories();
+  fmt::print("{} points, {} clusters\n",
+             hashed.size(),
+             std::count_if(sizes.begin(), sizes.end(), [](int n) {
+               return n > 0;
+             }));
+  fmt::print("exhaustive:   {:9.3f} ms\n", slow);
+  fmt::print("spatial hash: {:9.3f} ms, speedup {:.1f}x\n", fast, slow / fast);
+
+  DisjointSet organized;
+  auto start = std::chrono::steady_clock::now();
+  organized.reset();
+  organized.addOrganizedPoints(cloud, box);
+  sizes = organized.countCategories();
+  auto stop = std::chrono::steady_clock::now();
+  auto grid = std::chrono::duration<double, std::milli>(stop - start).count();
+
+  fmt::print("organized:    {:9.3f} ms, speedup {:.1f}x, {} clusters\n",
+             grid,
+             slow / grid,
+             std::count_if(sizes.begin(), sizes.end(), [](int n) {
+               return n > 0;
+             }));
+
+  DisjointSet tiled;
+  start = std::chrono::steady_clock::now();
+  tiled.reset();
+  tiled.addOrganizedPoints(cloud, box, true, &farsight::worker_pool());
+  tiled.countCategories();
+  stop = std::chrono::steady_clock::now();
+  auto tiles = std::chrono::duration<double, std::milli>(stop - start).count();
+
+  fmt::print("tiled:        {:9.3f} ms, {} threads\n",
+             tiles,
+             farsight::worker_pool().get_concurrency());
+
+  if (!same_partition(exhaustive, hashed) ||
+      !same_partition(organized, tiled))
+  {
+    fmt::print("partitions differ\n");
+    return 1;
+  }
+  fmt::print("partitions match\n");
+}
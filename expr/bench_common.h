@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+#include <fmt/format.h>
+#include <libfreenect2/libfreenect2.hpp>
+
+#include "config.hpp"
+
+// Shared by the benchmarks and checks on recorded frames
+
+// Frames in media/ are depth normalized by 4500 mm, the result is in mm.
+// Exits when the file is missing or short, zeros would pass silently.
+inline std::vector<float>
+load_frame(const char *path)
+{
+  std::vector<float> depth(depth_width * depth_height);
+  std::ifstream file(path, std::ios::binary);
+
+  file.read(reinterpret_cast<char *>(depth.data()),
+            depth.size() * sizeof(float));
+  if (!file)
+  {
+    fmt::print(stderr,
+               "Cannot read {} depth values from {}\n",
+               depth.size(),
+               path);
+    std::exit(1);
+  }
+
+  for (auto &d : depth)
+    d *= 4500.0f;
+
+  return depth;
+}
+
+// Intrinsics of the camera the frames in media/ were recorded with
+inline libfreenect2::Freenect2Device::IrCameraParams
+media_ir_params()
+{
+  libfreenect2::Freenect2Device::IrCameraParams params{};
+  params.fx = 365.456f;
+  params.fy = 365.456f;
+  params.cx = 254.878f;
+  params.cy = 205.395f;
+
+  return params;
+}
+
+// Mean wall time of one call in milliseconds
+template<typename F>
+double
+time_ms(int iterations, F &&f)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    f();
+  auto stop = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::milli>(stop - start).count() /
+         iterations;
+}
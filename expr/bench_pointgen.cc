@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "camera.h"
+#include "bench_common.h"
+#include "config.hpp"
+#include "depth_rays.h"
+#include "worker_pool.h"
+
+// Scaling of point generation and transformation with row bands spread
+// over 1..N threads.
+
+int
+main(int argc, char **argv)
+{
+  const char *path = argc > 1 ? argv[1] : "media/depth_raw0";
+  constexpr int iterations = 200;
+
+  auto depth = load_frame(path);
+
+  auto params = media_ir_params();
+
+  farsight::DepthRays rays;
+  rays.rebuild(params, depth_width, depth_height);
+
+  auto transform = farsight::camera_transform(
+    { 0.1f, 0.2f, 1.5f }, glm::mat3x3(1.0f), 1);
+
+  farsight::PointCloud cloud;
+  cloud.reserve(depth_width * depth_height);
+
+  double single = 0.0;
+  auto max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  for (unsigned threads = 1; threads <= max_threads; ++threads)
+  {
+    farsight::WorkerPool pool(threads - 1);
+
+    auto step = [&] {
+      cloud.clear();
+      rays.project(
+        depth.data(), 0, 0, depth_width, depth_height, cloud, 4.5f, &pool);
+      pool.parallel_for(0,
+                        cloud.size(),
+                        farsight::PointCloud::mask_bits,
+                        [&](size_t b, size_t e) {
+                          farsight::apply_transform(transform, cloud, b, e);
+                        });
+    };
+
+    // warm up caches and wake the workers once
+    step();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+      step();
+    auto stop = std::chrono::steady_clock::now();
+
+    double ms =
+      std::chrono::duration<double, std::milli>(stop - start).count() /
+      iterations;
+
+    if (threads == 1)
+      single = ms;
+
+    fmt::print("threads {:2}: {:7.3f} ms/frame, speedup {:.2f}x, {} points\n",
+               threads,
+               ms,
+               single / ms,
+               cloud.count_valid());
+  }
+}
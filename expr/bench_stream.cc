@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "bench_common.h"
+#include "camera.h"
+#include "config.hpp"
+#include "depth_rays.h"
+#include "disjoint_set.h"
+#include "frame_arena.h"
+#include "height_map.h"
+#include "measurement_stream.h"
+#include "object_cloud.h"
+#include "oriented_box.h"
+#include "voxel_grid.h"
+#include "worker_pool.h"
+
+// Rate and latency continuous measurement can sustain, on recorded
+// frames replayed as fast as the pipeline takes them. Every pair goes
+// through object_cloud, the per camera step createPointMaping runs, then
+// box fitting and the height map, and is published to a
+// MeasurementStream. Depth detection in OpenCV is not part of it, a
+// square box of the given side around the frame center stands in for
+// the detected one. Floor and distance cuts drop about a third of the
+// points of these frames.
+
+farsight::Context3D farsight::context3D;
+
+int
+main(int argc, char **argv)
+{
+  size_t box = argc > 1 ? std::stoul(argv[1]) : 200;
+  std::vector<const char *> paths(argv + std::min(argc, 2), argv + argc);
+  if (paths.empty())
+    paths = { "media/depth_raw0", "media/depth_raw1" };
+
+  constexpr int pairs = 300;
+  box = std::min({ box, depth_width, depth_height });
+  const size_t cameras = paths.size();
+
+  farsight::DepthRays rays;
+  rays.rebuild(media_ir_params(), depth_width, depth_height);
+
+  // cameras face each other across the origin, two meters apart
+  std::vector<std::vector<float>> frames;
+  std::vector<farsight::RigidTransform> world;
+  for (size_t k = 0; k < cameras; ++k)
+  {
+    frames.push_back(load_frame(paths[k]));
+
+    float side = k % 2 ? -1.0f : 1.0f;
+    glm::mat3x3 rot(1.0f);
+    rot[0][0] = side;
+    rot[2][2] = side;
+    world.push_back(
+      farsight::camera_transform({ 0.0f, 0.0f, 2.0f * side }, rot, 1));
+  }
+
+  auto &pool = farsight::worker_pool();
+  farsight::FrameArena arena(64 << 20);
+  farsight::ObjectCloudParams params;
+  params.floor_level = 0;
+  params.max_z = 2.0f;
+  params.voxels.leaf_size = 0.005f;
+  const float floor_y = farsight::FLOOR_BASE_Y + params.floor_level;
+
+  std::vector<DisjointSet> clusters(cameras);
+  arena.on_reset([&] {
+    for (auto &c : clusters)
+      c.reset();
+  });
+  std::vector<farsight::PointCloud> clouds(cameras);
+  std::vector<farsight::ClusterStats> stats(cameras);
+
+  farsight::HeightMap heights;
+  farsight::MeasurementStream stream;
+  stream.set_latency_target(1000.0 / 30);
+
+  for (int n = 0; n < pairs; ++n)
+  {
+    farsight::Measurement m;
+    m.captured = farsight::Measurement::Clock::now();
+    arena.reset();
+
+    for (size_t k = 0; k < cameras; ++k)
+    {
+      clouds[k] = farsight::object_cloud(rays,
+                                         frames[k].data(),
+                                         (depth_width - box) / 2,
+                                         (depth_height - box) / 2,
+                                         box,
+                                         box,
+                                         world[k],
+                                         params,
+                                         clusters[k],
+                                         &pool,
+                                         &arena);
+      stats[k] = clusters[k].getValidStats();
+    }
+
+    farsight::ClusterStats merged;
+    for (const auto &s : stats)
+      merged.merge(s);
+
+    farsight::BoxMeasurer measurer(merged, { 0, 1, 0 });
+    for (const auto &cloud : clouds)
+      measurer.add(cloud);
+    m.box = measurer.result();
+
+    heights.reset(m.box, floor_y, 0.01f);
+    for (const auto &cloud : clouds)
+      heights.add(cloud);
+    auto volume = heights.result();
+    m.volume = volume.volume;
+    m.footprint = volume.footprint;
+
+    stream.publish(m);
+  }
+
+  auto s = stream.get_latency_stats();
+  fmt::print("{} cameras, {}x{} pixel boxes, {} threads\n",
+             cameras,
+             box,
+             box,
+             pool.get_concurrency());
+  fmt::print("rate {:.1f} Hz, latency mean {:.2f} p95 {:.2f} max {:.2f} ms, "
+             "{} of {} over {:.1f} ms\n",
+             s.rate_hz,
+             s.mean_ms,
+             s.p95_ms,
+             s.max_ms,
+             s.over_target,
+             s.published,
+             s.target_ms);
+}
@@ -0,0 +1,204 @@
+#include <cmath>
+#include <cstring>
+
+#include <fmt/format.h>
+#include <opencv2/core/core.hpp>
+
+#include "bench_common.h"
+#include "config.hpp"
+#include "depth_rays.h"
+#include "offscreen_view.h"
+
+// Offscreen render of media/depth_raw0 checked against reference pixel
+// positions, and for determinism: the same scene rendered twice by one
+// view and once by another view gives identical pixels. Exits with 1 on
+// any failure, with 77, which ctest reports as skipped, without EGL.
+
+constexpr int width = 320, height = 240;
+
+// Reference positions in pixels, x right and y down from the top left
+// corner. Projected on the CPU with the gluPerspective and gluLookAt
+// matrices of the view, the cloud centroid is the one of the pixels hit
+// by the posed points of media/depth_raw0.
+constexpr float mark_corners[4][2] = {
+  { 160.00f, 137.31f },
+  { 189.83f, 120.00f },
+  { 160.00f, 107.24f },
+  { 130.17f, 120.00f },
+};
+constexpr float cloud_centroid[2] = { 201.52f, 107.97f };
+// Z axis is white like the points, pixels near it are left out
+constexpr float z_axis[2][2] = { { 160.00f, 120.00f }, { 124.84f, 137.31f } };
+constexpr float tolerance = 1.0f;
+
+static bool
+is_mark(const unsigned char *p)
+{
+  return p[0] == 255 && p[1] == 0 && p[2] == 0;
+}
+
+static bool
+is_point(const unsigned char *p)
+{
+  return p[0] == 255 && p[1] == 255 && p[2] == 255;
+}
+
+static double
+axis_distance(double x, double y)
+{
+  double dx = z_axis[1][0] - z_axis[0][0], dy = z_axis[1][1] - z_axis[0][1];
+
+  return std::fabs(dy * (x - z_axis[0][0]) - dx * (y - z_axis[0][1])) /
+         std::hypot(dx, dy);
+}
+
+// Mark pixel within tolerance of every corner, none outside of them
+static bool
+check_mark(const cv::Mat &image)
+{
+  float min_x = width, min_y = height, max_x = 0, max_y = 0;
+  for (const auto &c : mark_corners)
+  {
+    min_x = std::min(min_x, c[0]);
+    min_y = std::min(min_y, c[1]);
+    max_x = std::max(max_x, c[0]);
+    max_y = std::max(max_y, c[1]);
+  }
+
+  bool found[4] = {};
+  size_t count = 0, outside = 0;
+
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      if (!is_mark(image.data + 3 * (y * width + x)))
+        continue;
+
+      float cx = x + 0.5f, cy = y + 0.5f;
+      count++;
+      outside += cx < min_x - tolerance || cx > max_x + tolerance ||
+                 cy < min_y - tolerance || cy > max_y + tolerance;
+
+      for (int i = 0; i < 4; ++i)
+      {
+        found[i] |= std::hypot(cx - mark_corners[i][0],
+                               cy - mark_corners[i][1]) <= tolerance;
+      }
+    }
+  }
+
+  bool ok = count && !outside;
+  for (int i = 0; i < 4; ++i)
+  {
+    if (!found[i])
+      fmt::print("mark corner {} not at {} {}\n",
+                 i,
+                 mark_corners[i][0],
+                 mark_corners[i][1]);
+    ok &= found[i];
+  }
+  fmt::print("{} mark pixels, {} outside of the corners\n", count, outside);
+
+  return ok;
+}
+
+static bool
+check_cloud(const cv::Mat &image)
+{
+  double sx = 0, sy = 0;
+  size_t count = 0;
+
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      double cx = x + 0.5, cy = y + 0.5;
+      if (!is_point(image.data + 3 * (y * width + x)) ||
+          axis_distance(cx, cy) < 2)
+        continue;
+
+      sx += cx;
+      sy += cy;
+      count++;
+    }
+  }
+
+  if (!count)
+  {
+    fmt::print("no point pixels\n");
+    return false;
+  }
+
+  double x = sx / count, y = sy / count;
+  double off = std::hypot(x - cloud_centroid[0], y - cloud_centroid[1]);
+  fmt::print("{} point pixels, centroid {:.2f} {:.2f}, {:.2f} px off\n",
+             count,
+             x,
+             y,
+             off);
+
+  return off <= tolerance;
+}
+
+static bool
+same_image(const cv::Mat &a, const cv::Mat &b)
+{
+  return a.rows == b.rows && a.cols == b.cols &&
+         std::memcmp(a.data, b.data, a.total() * a.elemSize()) == 0;
+}
+
+int
+main()
+{
+  auto depth = load_frame("media/depth_raw0");
+
+  farsight::DepthRays rays;
+  rays.rebuild(media_ir_params(), depth_width, depth_height);
+
+  farsight::PointCloud cloud;
+  rays.project(
+    depth.data(), 0, 0, depth_width, depth_height, cloud, 4.5f);
+
+  // camera two meters away looking back at the origin, floor out of the way
+  farsight::Context3D scene(1);
+  scene.update(0, std::move(cloud));
+  scene.set_rvec(0, { float(M_PI), 0.0f, 0.0f });
+  scene.set_tvec(0, { 0.0f, 0.0f, -2.0f });
+  scene.set_floor_level(-5.0f);
+
+  // blue, no axis has that color
+  farsight::Rectfc mark;
+  mark.verts[0] = { 0.5f, 0.0f, 0.5f, farsight::BLUE };
+  mark.verts[1] = { 0.5f, 0.0f, -0.5f, farsight::BLUE };
+  mark.verts[2] = { -0.5f, 0.0f, -0.5f, farsight::BLUE };
+  mark.verts[3] = { -0.5f, 0.0f, 0.5f, farsight::BLUE };
+  mark.color = farsight::BLUE;
+  scene.mark(mark, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f });
+
+  const glm::vec3 eye{ 2.5f, 2.0f, 2.5f }, center{ 0.0f, 0.0f, 0.0f };
+
+  farsight::OffscreenView view(width, height);
+  if (!view.ready())
+  {
+    fmt::print(stderr, "Offscreen view failed: {}\n", view.get_error());
+    return 77;
+  }
+
+  auto first = view.render(scene, eye, center);
+  auto again = view.render(scene, eye, center);
+
+  farsight::OffscreenView other(width, height);
+  auto second = other.render(scene, eye, center);
+
+  bool mark_ok = check_mark(first);
+  bool cloud_ok = check_cloud(first);
+  bool same_view = same_image(first, again);
+  bool same_other = same_image(first, second);
+
+  fmt::print("same view: {}, second view: {}\n",
+             same_view ? "identical" : "DIFFERENT",
+             same_other ? "identical" : "DIFFERENT");
+
+  return mark_ok && cloud_ok && same_view && same_other ? 0 : 1;
+}
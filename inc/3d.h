@@ -5,10 +5,6 @@
 
 #include "types.h"
 
-extern "C" {
-void glutPostRedisplay();
-}
-
 namespace farsight {
 
   extern Context3D context3D;
@@ -17,87 +13,63 @@ namespace farsight {
   init3d();
 
   inline void
-  update_points_cam1(PointArraySimple points, size_t width)
+  set_camera_count(size_t cameras)
   {
-    context3D.update_cam1(PointArray(std::begin(points), std::end(points)), width);
+    context3D.set_camera_count(cameras);
   }
 
-  inline void
-  update_points_cam1(PointArray points, size_t width)
+  inline size_t
+  get_camera_count()
   {
-    context3D.update_cam1(std::move(points), width);
+    return context3D.get_camera_count();
   }
 
   inline void
-  update_points_cam2(PointArraySimple points, size_t width)
+  update_points(size_t cam, PointArraySimple points, size_t width)
   {
-    context3D.update_cam1(PointArray(std::begin(points), std::end(points)), width);
+    context3D.update(cam, PointCloud::from_point_array(points, width));
   }
 
   inline void
-  update_points_cam2(PointArray points, size_t width)
-  {
-    context3D.update_cam2(std::move(points), width);
-  }
-
-  inline glm::vec3
-  get_tvec_cam1()
+  update_points(size_t cam, const PointCloud &points)
   {
-    return context3D.get_tvec_cam1();
+    context3D.update(cam, points);
   }
 
-  inline glm::vec3
-  get_rvec_cam1()
+  inline void
+  update_points(size_t cam, PointCloud &&points)
   {
-    return context3D.get_rvec_cam1();
+    context3D.update(cam, std::move(points));
   }
 
   inline glm::vec3
-  get_tvec_cam2()
+  get_tvec(size_t cam)
   {
-    return context3D.get_tvec_cam2();
+    return context3D.get_tvec(cam);
   }
 
   inline glm::vec3
-  get_rvec_cam2()
-  {
-    return context3D.get_rvec_cam2();
-  }
-
-  inline void
-  set_tvec_cam1(glm::vec3 v)
-  {
-    context3D.set_tvec_cam1(v);
-  }
-
-  inline void
-  set_rvec_cam1(glm::vec3 v)
+  get_rvec(size_t cam)
   {
-    context3D.set_rvec_cam1(v);
+    return context3D.get_rvec(cam);
   }
 
   inline void
-  set_tvec_cam2(glm::vec3 v)
+  set_tvec(size_t cam, glm::vec3 v)
   {
-    context3D.set_tvec_cam2(v);
+    context3D.set_tvec(cam, v);
   }
 
   inline void
-  set_rvec_cam2(glm::vec3 v)
-  {
-    context3D.set_rvec_cam2(v);
-  }
-
-  inline Context3D::PointInfo
-  get_translated_points_cam1()
+  set_rvec(size_t cam, glm::vec3 v)
   {
-    return context3D.get_translated_points_cam1();
+    context3D.set_rvec(cam, v);
   }
 
   inline Context3D::PointInfo
-  get_translated_points_cam2()
+  get_translated_points(size_t cam)
   {
-    return context3D.get_translated_points_cam2();
+    return context3D.get_translated_points(cam);
   }
 
   inline void
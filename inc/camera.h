@@ -5,12 +5,18 @@
 #include <glm/glm.hpp>
 
 #include "types.h"
+#include "worker_pool.h"
 
 namespace farsight {
+  // Composed transform from camera space to world space (front marker)
+  RigidTransform
+  camera_transform(glm::vec3 tvec, glm::mat3x3 rot, int id = 0);
+
   void
-  camera2real(PointArray &points,
+  camera2real(PointCloud &points,
               glm::vec3 tvec,
               glm::mat3x3 rvec = glm::mat3x3(1),
-              int id = 0
+              int id = 0,
+              WorkerPool *pool = nullptr
               );
 }
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+namespace farsight {
+
+  // Writes point clouds to binary PLY files on a background thread. The
+  // processing thread only queues handles, clouds stay alive through
+  // them until written. A full queue drops the dump instead of stalling
+  // the caller. Disabled, dump returns at once and no thread is started.
+  // Dumpers start disabled, production never writes a file.
+  class CloudDumper
+  {
+  public:
+    using CloudPtr = std::shared_ptr<const PointCloud>;
+
+    explicit CloudDumper(size_t max_queue = 8);
+    // Writes what is still queued
+    ~CloudDumper();
+
+    CloudDumper(const CloudDumper &) = delete;
+    CloudDumper &
+    operator=(const CloudDumper &) = delete;
+
+    void
+    set_enabled(bool on)
+    {
+      enabled = on;
+    }
+
+    bool
+    is_enabled() const
+    {
+      return enabled;
+    }
+
+    // Valid points of all clouds into one file, coordinates in
+    // millimeters as the text dumps had them. False when disabled or
+    // dropped.
+    bool
+    dump(std::string path, std::vector<CloudPtr> clouds);
+
+    size_t
+    get_written() const
+    {
+      return written;
+    }
+
+    size_t
+    get_dropped() const
+    {
+      return dropped;
+    }
+
+  private:
+    struct Job
+    {
+      std::string path;
+      std::vector<CloudPtr> clouds;
+    };
+
+    void
+    writer();
+
+    const size_t max_queue;
+    std::atomic<bool> enabled = false;
+    std::atomic<size_t> written = 0, dropped = 0;
+
+    std::mutex mtx;
+    std::condition_variable queued;
+    std::deque<Job> jobs;
+    std::thread thread;
+    bool stop = false;
+  };
+
+  // Writes the file synchronously, false when it cannot be written
+  bool
+  write_ply(const std::string &path,
+            const std::vector<CloudDumper::CloudPtr> &clouds);
+
+  // Dumper of the application, off unless enabled from the floor window
+  CloudDumper &
+  cloud_dumper();
+
+} // namespace farsight
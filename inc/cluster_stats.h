@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+
+namespace farsight {
+
+  // Running summary of a set of points. Only sums are kept, so summaries
+  // of two sets merge into the summary of their union in constant time.
+  struct ClusterStats
+  {
+    size_t count = 0;
+    Point3f min = { INFINITY, INFINITY, INFINITY };
+    Point3f max = { -INFINITY, -INFINITY, -INFINITY };
+
+    // sums of coordinates and of their products, xx xy xz yy yz zz
+    double sum[3] = {};
+    double sum_sq[6] = {};
+
+    void
+    add(float x, float y, float z)
+    {
+      count++;
+
+      min = { std::min(min.x, x), std::min(min.y, y), std::min(min.z, z) };
+      max = { std::max(max.x, x), std::max(max.y, y), std::max(max.z, z) };
+
+      sum[0] += x;
+      sum[1] += y;
+      sum[2] += z;
+
+      sum_sq[0] += double(x) * x;
+      sum_sq[1] += double(x) * y;
+      sum_sq[2] += double(x) * z;
+      sum_sq[3] += double(y) * y;
+      sum_sq[4] += double(y) * z;
+      sum_sq[5] += double(z) * z;
+    }
+
+    void
+    merge(const ClusterStats &o)
+    {
+      count += o.count;
+
+      min = { std::min(min.x, o.min.x),
+              std::min(min.y, o.min.y),
+              std::min(min.z, o.min.z) };
+      max = { std::max(max.x, o.max.x),
+              std::max(max.y, o.max.y),
+              std::max(max.z, o.max.z) };
+
+      for (int i = 0; i < 3; ++i)
+        sum[i] += o.sum[i];
+      for (int i = 0; i < 6; ++i)
+        sum_sq[i] += o.sum_sq[i];
+    }
+
+    bool
+    empty() const
+    {
+      return count == 0;
+    }
+
+    Point3f
+    centroid() const
+    {
+      if (empty())
+        return { NAN, NAN, NAN };
+
+      return { float(sum[0] / count),
+               float(sum[1] / count),
+               float(sum[2] / count) };
+    }
+
+    // Population covariance, symmetric
+    glm::mat3x3
+    covariance() const
+    {
+      if (empty())
+        return glm::mat3x3(0);
+
+      double mean[3] = { sum[0] / count, sum[1] / count, sum[2] / count };
+      const int at[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+
+      glm::mat3x3 cov;
+      for (int c = 0; c < 3; ++c)
+        for (int r = 0; r < 3; ++r)
+          cov[c][r] = sum_sq[at[c][r]] / count - mean[c] * mean[r];
+
+      return cov;
+    }
+  };
+
+} // namespace farsight
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <libfreenect2/libfreenect2.hpp>
+#include <libfreenect2/registration.h>
+
+#include "types.h"
+#include "worker_pool.h"
+
+namespace farsight {
+
+  // Per-pixel ray table of the depth camera. Every pixel stores its ray
+  // direction as (x/z, y/z) so converting depth to XYZ is a multiply of
+  // the depth plane by the two ray planes, no per pixel intrinsics math.
+  class DepthRays
+  {
+  public:
+    using IrParams = libfreenect2::Freenect2Device::IrCameraParams;
+
+    DepthRays() = default;
+
+    // Has to be called again whenever the IR intrinsics are recalibrated
+    void
+    rebuild(const IrParams &params, size_t width, size_t height);
+
+    // Converts depth (in millimeters) of the given pixel rectangle to
+    // points in meters, appending them to out in row major order.
+    // Pixels without depth or further than max_z are left invalid.
+    // With a pool, bands of the output are filled by its threads.
+    void
+    project(const float *depth,
+            size_t x,
+            size_t y,
+            size_t w,
+            size_t h,
+            PointCloud &out,
+            float max_z = INFINITY,
+            WorkerPool *pool = nullptr) const;
+
+    // Compares the table with Registration::getPointXYZ on every pixel
+    bool
+    matches(const libfreenect2::Registration &reg, float tolerance) const;
+
+    bool
+    ready() const
+    {
+      return !ray_x.empty();
+    }
+
+    size_t
+    get_width() const
+    {
+      return width;
+    }
+
+    size_t
+    get_height() const
+    {
+      return height;
+    }
+
+  private:
+    // Fills out[first, last) of a rectangle starting at out[begin]
+    void
+    project_range(const float *depth,
+                  size_t x,
+                  size_t y,
+                  size_t w,
+                  size_t begin,
+                  size_t first,
+                  size_t last,
+                  PointCloud &out,
+                  float max_z) const;
+
+    size_t width = 0, height = 0;
+    std::vector<float> ray_x, ray_y;
+  };
+
+} // namespace farsight
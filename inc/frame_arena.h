@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace farsight {
+
+  // Pass through resource counting what reaches the upstream allocator
+  class CountingResource : public std::pmr::memory_resource
+  {
+  public:
+    explicit CountingResource(
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : upstream(upstream)
+    {}
+
+    size_t
+    get_allocations() const
+    {
+      return allocations;
+    }
+
+    size_t
+    get_bytes() const
+    {
+      return bytes;
+    }
+
+    void
+    reset_counters()
+    {
+      allocations = 0;
+      bytes = 0;
+    }
+
+  private:
+    void *
+    do_allocate(size_t size, size_t alignment) override
+    {
+      ++allocations;
+      bytes += size;
+      return upstream->allocate(size, alignment);
+    }
+
+    void
+    do_deallocate(void *p, size_t size, size_t alignment) override
+    {
+      upstream->deallocate(p, size, alignment);
+    }
+
+    bool
+    do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override
+    {
+      return this == &other;
+    }
+
+    std::pmr::memory_resource *upstream;
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> bytes = 0;
+  };
+
+  // Monotonic arena for temporaries living no longer than one frame.
+  // Backing buffer is allocated once, reset rewinds to its beginning, so
+  // a frame fitting in the buffer does not touch the heap at all. Whatever
+  // does not fit spills to the heap and shows up in heap_allocations.
+  // Those count the arena only, HeapCounter counts every allocation when
+  // built with COUNT_HEAP_ALLOCATIONS.
+  class FrameArena : public std::pmr::memory_resource
+  {
+  public:
+    explicit FrameArena(size_t capacity)
+      : capacity(capacity)
+      , buffer(std::make_unique<std::byte[]>(capacity))
+      , arena(buffer.get(), capacity, &heap)
+    {}
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &
+    operator=(const FrameArena &) = delete;
+
+    // Called by every reset before the memory is released, for objects
+    // outliving the frame to let go of their arena storage while it is
+    // still there
+    void
+    on_reset(std::function<void()> release)
+    {
+      releases.push_back(std::move(release));
+    }
+
+    // Everything allocated from the arena is gone after this call
+    void
+    reset()
+    {
+      for (auto &release : releases)
+        release();
+      arena.release();
+      heap.reset_counters();
+      allocations = 0;
+      used = 0;
+    }
+
+    size_t
+    get_capacity() const
+    {
+      return capacity;
+    }
+
+    size_t
+    get_used() const
+    {
+      return used;
+    }
+
+    size_t
+    get_allocations() const
+    {
+      return allocations;
+    }
+
+    size_t
+    heap_allocations() const
+    {
+      return heap.get_allocations();
+    }
+
+    size_t
+    heap_bytes() const
+    {
+      return heap.get_bytes();
+    }
+
+  private:
+    void *
+    do_allocate(size_t size, size_t alignment) override
+    {
+      ++allocations;
+      used += size;
+      return arena.allocate(size, alignment);
+    }
+
+    void
+    do_deallocate(void *p, size_t size, size_t alignment) override
+    {
+      // monotonic, memory is reclaimed by reset
+      arena.deallocate(p, size, alignment);
+    }
+
+    bool
+    do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override
+    {
+      return this == &other;
+    }
+
+    size_t capacity;
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> used = 0;
+    std::unique_ptr<std::byte[]> buffer;
+    CountingResource heap;
+    std::pmr::monotonic_buffer_resource arena;
+    std::vector<std::function<void()>> releases;
+  };
+
+} // namespace farsight
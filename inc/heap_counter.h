@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+namespace farsight {
+
+#ifdef FARSIGHT_COUNT_HEAP
+  constexpr bool heap_counting = true;
+#else
+  // Counts stay zero unless built with COUNT_HEAP_ALLOCATIONS
+  constexpr bool heap_counting = false;
+#endif
+
+  struct HeapCount
+  {
+    size_t allocations = 0;
+    size_t bytes = 0;
+  };
+
+  // Allocations through the global operator new since program start,
+  // counted by the replacement operators in heap_counter.cc. Memory
+  // resources count as soon as they reach operator new, spills of
+  // FrameArena included.
+  HeapCount
+  heap_count();
+
+  // Same, made by the calling thread only
+  HeapCount
+  thread_heap_count();
+
+  // Allocations made since construction. Other threads keep running, so
+  // the process count also includes the 3d view and the drivers.
+  class HeapCounter
+  {
+  public:
+    HeapCounter()
+      : process_start(heap_count())
+      , thread_start(thread_heap_count())
+    {}
+
+    HeapCount
+    process() const
+    {
+      return since(process_start, heap_count());
+    }
+
+    HeapCount
+    thread() const
+    {
+      return since(thread_start, thread_heap_count());
+    }
+
+  private:
+    static HeapCount
+    since(HeapCount start, HeapCount now)
+    {
+      return { now.allocations - start.allocations, now.bytes - start.bytes };
+    }
+
+    HeapCount process_start, thread_start;
+  };
+
+} // namespace farsight
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "oriented_box.h"
+#include "types.h"
+
+namespace farsight {
+
+  struct HeightMapStats
+  {
+    // Under the top surface down to the floor, m^3
+    double volume = 0;
+    // Area of the cells with anything above the floor, m^2
+    double footprint = 0;
+    // Highest cell above the floor, m
+    float top = 0;
+    size_t occupied = 0;
+  };
+
+  // Floor plane grid keeping the highest point of every cell, for the
+  // volume of objects standing on the floor. The grid lies under an
+  // oriented box measured with the floor normal as up, its cells follow
+  // the footprint axes, so box edges fall on cell edges. Cells on the
+  // outline of a footprint that is no rectangle are only partly covered
+  // but count whole, they inflate footprint and volume. Space under the
+  // top surface counts as filled, as the cameras never see it anyway.
+  class HeightMap
+  {
+  public:
+    HeightMap() = default;
+
+    // cell_size and floor_y in meters, floor_y as clip_floor uses it.
+    // Cells are at most cell_size on a side.
+    HeightMap(const OrientedBox &box, float floor_y, float cell_size);
+
+    // Empty grid under another box, reusing the storage of the cells
+    void
+    reset(const OrientedBox &box, float floor_y, float cell_size);
+
+    // One pass over the points, may be called for every cloud of a fused
+    // measurement
+    void
+    add(const PointCloud &cloud);
+
+    // One pass over the cells
+    HeightMapStats
+    result() const;
+
+    size_t
+    get_cols() const
+    {
+      return cols;
+    }
+
+    size_t
+    get_rows() const
+    {
+      return rows;
+    }
+
+    // Row major heights above the floor, rows along the second box axis
+    const float *
+    get_cells() const
+    {
+      return cells.data();
+    }
+
+  private:
+    glm::vec3 origin = { 0, 0, 0 };
+    // footprint axes scaled to cells per meter
+    glm::vec3 u = { 0, 0, 0 }, v = { 0, 0, 0 };
+    float floor_y = 0;
+    double cell_area = 0;
+    size_t cols = 0, rows = 0;
+    std::vector<float> cells;
+  };
+
+} // namespace farsight
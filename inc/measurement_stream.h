@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "oriented_box.h"
+
+namespace farsight {
+
+  struct Measurement
+  {
+    using Clock = std::chrono::steady_clock;
+
+    // Numbered from 1 in publishing order
+    uint64_t sequence = 0;
+    OrientedBox box;
+    // Top of the box above the floor in meters
+    double height = 0;
+    // Of the height map under the box, m^3 and m^2
+    double volume = 0, footprint = 0;
+    // Arrival of the earliest frame the result was measured from
+    Clock::time_point captured;
+    // Spread of the arrival times of the frames of all cameras
+    double skew_ms = 0;
+    // From captured until the result was published
+    double latency_ms = 0;
+  };
+
+  struct LatencyStats
+  {
+    double target_ms = 0;
+    // Over the results kept in the history only
+    size_t count = 0;
+    double rate_hz = 0;
+    double mean_ms = 0, p95_ms = 0, max_ms = 0;
+    // Since the target was last set
+    size_t over_target = 0;
+    size_t published = 0;
+  };
+
+  // Results of continuous measurement. The producer publishes every
+  // result, readers either poll the latest one or wait for the next.
+  // Like the shots of Context3D, the latest result is an immutable
+  // snapshot swapped in with an atomic shared_ptr store, so polling
+  // readers never wait for the producer.
+  class MeasurementStream
+  {
+  public:
+    using Clock = Measurement::Clock;
+    using Ptr = std::shared_ptr<const Measurement>;
+
+    // Results the latency statistics are computed over
+    constexpr static size_t history = 256;
+
+    // Numbers the result, stamps its latency and wakes waiting readers
+    void
+    publish(Measurement m);
+
+    // Null until the first result
+    Ptr
+    latest() const
+    {
+      return std::atomic_load(&current);
+    }
+
+    // Latest result once one newer than sequence is published, null on
+    // timeout. Results published in between are skipped, a gap in the
+    // sequence numbers tells how many.
+    Ptr
+    wait_next(uint64_t sequence, std::chrono::milliseconds timeout) const;
+
+    // Results slower than target count as missed, 0 disables counting
+    void
+    set_latency_target(double ms);
+
+    LatencyStats
+    get_latency_stats() const;
+
+  private:
+    Ptr current;
+
+    mutable std::mutex mtx;
+    mutable std::condition_variable next;
+    // Ring of the latest latencies and publish times
+    std::vector<double> latencies;
+    std::vector<Clock::time_point> published;
+    uint64_t sequence = 0;
+    double target_ms = 0;
+    size_t over_target = 0, since_target = 0;
+  };
+
+  // Stream of the application, fed by the continuous measurement mode
+  MeasurementStream &
+  measurement_stream();
+
+} // namespace farsight
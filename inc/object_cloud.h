@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <memory_resource>
+
+#include "depth_rays.h"
+#include "types.h"
+#include "voxel_grid.h"
+#include "worker_pool.h"
+
+class DisjointSet;
+
+namespace farsight {
+
+  struct ObjectCloudParams
+  {
+    // As set_floor_level takes it, points at or below the floor are cut
+    float floor_level = 0;
+    // Points farther along world z are cut, meters
+    float max_z = INFINITY;
+    // Clusters of the previous frame are kept, pixels moving less than
+    // tolerance meters keep their cluster
+    bool incremental = false;
+    double tolerance = 0;
+    VoxelGridParams voxels;
+  };
+
+  // Per camera step of a measurement, the same for single 'r' steps,
+  // continuous measurement and benchmarks. Pixels of the w x h box at
+  // x, y are projected, moved to world space and cut at the floor and
+  // max_z. The cloud stays organized as the box, clustering follows the
+  // pixel grid. Valid clusters come back downsampled, allocated from
+  // resource. Unless incremental, clusters are reset onto resource first.
+  // Incremental clustering stores the pixels clustered again in
+  // reclustered.
+  PointCloud
+  object_cloud(const DepthRays &rays,
+               const float *depth,
+               size_t x,
+               size_t y,
+               size_t w,
+               size_t h,
+               const RigidTransform &world,
+               const ObjectCloudParams &params,
+               DisjointSet &clusters,
+               WorkerPool *pool = nullptr,
+               std::pmr::memory_resource *resource =
+                 std::pmr::get_default_resource(),
+               size_t *reclustered = nullptr);
+
+} // namespace farsight
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <GL/gl.h>
+#include <glm/glm.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "point_renderer.h"
+#include "types.h"
+
+namespace farsight {
+
+  // Renders the Context3D scene without a window or X display, into a
+  // framebuffer of an EGL surfaceless context (Mesa llvmpipe works).
+  // The context is made current only inside render, so any thread may
+  // use the view, but only one at a time.
+  class OffscreenView
+  {
+  public:
+    OffscreenView(int width, int height);
+    ~OffscreenView();
+
+    OffscreenView(const OffscreenView &) = delete;
+    OffscreenView &
+    operator=(const OffscreenView &) = delete;
+
+    // False when no EGL display or GL context could be created,
+    // get_error tells why
+    bool
+    ready() const
+    {
+      return framebuffer != 0;
+    }
+
+    const std::string &
+    get_error() const
+    {
+      return error;
+    }
+
+    // Current snapshot of the scene seen from eye, same projection as
+    // the 3d view. Returns a BGR image with the top row first, empty
+    // when the view is not ready.
+    cv::Mat
+    render(const Context3D &scene,
+           glm::vec3 eye,
+           glm::vec3 center,
+           glm::vec3 up = { 0.0f, 1.0f, 0.0f });
+
+  private:
+    bool
+    make_current();
+
+    void
+    release();
+
+    int width, height;
+    std::string error;
+
+    // EGLDisplay and EGLContext, EGL headers stay out of this header
+    // since they pull in X11 macros that break OpenCV
+    void *display = nullptr;
+    void *context = nullptr;
+
+    GLuint framebuffer = 0;
+    GLuint color = 0, depth = 0;
+    std::unique_ptr<PointRenderer> renderer;
+  };
+
+} // namespace farsight
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "cluster_stats.h"
+#include "types.h"
+
+namespace farsight {
+
+  struct OrientedBox
+  {
+    Point3f center = { 0, 0, 0 };
+    // Unit axes, the first two span the footprint with the longer side
+    // first, the third is the projection normal
+    glm::vec3 axes[3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    // Full side lengths along axes
+    glm::vec3 extents = { 0, 0, 0 };
+    // RMS distance of the outline points to the faces across each axis.
+    // Near zero when the cloud really is box shaped.
+    glm::vec3 residuals = { 0, 0, 0 };
+    size_t count = 0;
+  };
+
+  // Oriented bounding box of a cloud, measured in one streaming pass.
+  //
+  // The frame comes from the covariance of ClusterStats, which clustering
+  // accumulates anyway, so it is known before the first point is read.
+  // The pass keeps for every angular sector around the centroid only the
+  // outermost and the highest point of the footprint. Rotating calipers
+  // on the hull of those points then give the minimal footprint
+  // rectangle, no copy of the cloud is ever made.
+  class BoxMeasurer
+  {
+  public:
+    // Sectors of the footprint outline, a hull built from them is off
+    // by less than 0.1% of the footprint radius
+    constexpr static size_t sectors = 256;
+
+    // stats should describe the points that get added, only the frame
+    // depends on them. A non zero up fixes the normal to it, as for
+    // objects lying on the floor, otherwise the normal is the principal
+    // axis of least variance.
+    explicit BoxMeasurer(const ClusterStats &stats,
+                         glm::vec3 up = { 0, 0, 0 });
+
+    // May be called once for every cloud of a fused measurement
+    void
+    add(const PointCloud &cloud);
+
+    OrientedBox
+    result() const;
+
+  private:
+    struct Sector
+    {
+      float radius_sq = -1;
+      float s = 0, t = 0;
+      float top = -INFINITY;
+    };
+
+    glm::vec3 origin;
+    glm::vec3 u, v, n;
+
+    std::vector<Sector> outline;
+    float low = INFINITY, high = -INFINITY;
+    size_t count = 0;
+  };
+
+} // namespace farsight
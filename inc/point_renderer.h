@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GL/gl.h>
+#include <glm/glm.hpp>
+
+#include "types.h"
+
+namespace farsight {
+
+  // Draws the camera shots of Context3D from vertex buffers. A camera's
+  // buffer holds its points in camera space and is refilled only when
+  // new points get published. Pose and floor clipping are applied by a
+  // vertex shader, so moving a camera costs a few uniforms per frame.
+  //
+  // Points are stored coarse to fine, every detail level is a prefix of
+  // the buffer holding every 2nd, 4th or 8th point of the finer level.
+  // Each camera draws the shortest prefix that still covers its screen
+  // footprint, scaled down further while frames miss the frame time
+  // target. All calls need the GL context the renderer was first used
+  // with.
+  class PointRenderer
+  {
+  public:
+    // Level 0 keeps every 8th point, the last level all of them
+    constexpr static size_t lod_levels = 4;
+
+    PointRenderer() = default;
+    ~PointRenderer();
+
+    PointRenderer(const PointRenderer &) = delete;
+    PointRenderer &
+    operator=(const PointRenderer &) = delete;
+
+    void
+    draw(const Context3D::Shots &shots);
+
+    // Duration of the frame drawn last, drives the detail scale
+    void
+    report_frame(double frame_ms);
+
+    // Zero draws every point regardless of distance and frame time
+    void
+    set_frame_target(double ms)
+    {
+      frame_target_ms = ms;
+      detail = 1.0;
+    }
+
+    // Fraction of the density driven detail currently drawn
+    double
+    get_detail() const
+    {
+      return detail;
+    }
+
+    // Points drawn by the last draw call, floor clipped ones included
+    size_t
+    get_point_count() const
+    {
+      return point_count;
+    }
+
+    // Duration of the most recent buffer refill, packing included
+    double
+    get_upload_ms() const
+    {
+      return upload_ms;
+    }
+
+    // Shader compiler and linker errors, empty when the shader works
+    const std::string &
+    get_program_log() const
+    {
+      return program_log;
+    }
+
+  private:
+    struct Vertex
+    {
+      float x, y, z;
+      uint32_t color;
+    };
+
+    struct Buffer
+    {
+      Context3D::PointInfo points;
+      GLuint id = 0;
+      size_t capacity = 0;
+      // points up to and including each level
+      GLsizei count[lod_levels] = {};
+      // bounding sphere in camera space
+      glm::vec3 center{ 0.0f, 0.0f, 0.0f };
+      float radius = 0.0f;
+    };
+
+    void
+    build_program();
+
+    void
+    upload(Buffer &buffer, const PointCloud &points);
+
+    // Shortest prefix keeping at most max_density points per pixel of
+    // the bounding sphere projection, projection set up by the caller
+    GLsizei
+    pick_count(const Buffer &buffer, const CameraShot &shot) const;
+
+    GLuint program = 0;
+    std::string program_log;
+    GLint pose_rot_loc = -1, pose_t_loc = -1, floor_y_loc = -1;
+    std::vector<Buffer> buffers;
+    std::vector<Vertex> staging;
+    size_t point_count = 0;
+    double upload_ms = 0;
+    double frame_target_ms = 1000.0 / 60;
+    double detail = 1.0;
+
+    // Per frame projection values used by pick_count
+    glm::vec3 eye{ 0.0f, 0.0f, 0.0f };
+    float pixels_per_unit = 0.0f;
+  };
+
+} // namespace farsight
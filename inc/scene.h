@@ -0,0 +1,15 @@
+#pragma once
+
+#include "point_renderer.h"
+#include "types.h"
+
+namespace farsight {
+
+  // Axes, camera clouds and marks in world coordinates. Uses the matrices
+  // and viewport already set up, shared by the window and offscreen views.
+  void
+  draw_scene(PointRenderer &renderer,
+             const Context3D::Shots &shots,
+             const RectArray &marks);
+
+} // namespace farsight
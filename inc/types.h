@@ -1,7 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <new>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -152,205 +158,708 @@ namespace farsight {
   using PointArray = std::vector<Point3fc>;
   using RectArray = std::vector<Rectfc>;
 
-  struct CameraShot
+  // Allocator handing out cache line aligned storage, so every plane of
+  // a PointCloud starts at a vector register friendly address. Memory
+  // comes from a pmr resource, per frame arena or the default heap one.
+  template<typename T, size_t Alignment = 64>
+  struct AlignedAllocator
   {
-    size_t width = 1;
-    PointArray points{ { 0, 0, 0, WHITE } };
-    glm::vec3 tvec{ 0.0f, 0.0f, 0.0f };
-    glm::vec3 rvec{ 0.0f, 0.0f, 0.0f };
-    float floor_level = 0.0f;
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+      using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator(
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : resource(resource)
+    {}
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &other)
+      : resource(other.resource)
+    {}
+
+    T *
+    allocate(size_t n)
+    {
+      return static_cast<T *>(resource->allocate(n * sizeof(T), Alignment));
+    }
+
+    void
+    deallocate(T *p, size_t n)
+    {
+      resource->deallocate(p, n * sizeof(T), Alignment);
+    }
+
+    // Copies always go to the default resource, so a long living copy
+    // never points into an arena that is reset every frame
+    AlignedAllocator
+    select_on_container_copy_construction() const
+    {
+      return {};
+    }
+
+    template<typename U>
+    bool
+    operator==(const AlignedAllocator<U, Alignment> &other) const
+    {
+      return resource == other.resource || resource->is_equal(*other.resource);
+    }
+
+    template<typename U>
+    bool
+    operator!=(const AlignedAllocator<U, Alignment> &other) const
+    {
+      return !(*this == other);
+    }
+
+    std::pmr::memory_resource *resource;
   };
 
-  struct Context3D
+  template<typename T>
+  using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+  // Structure of arrays point cloud. Coordinates and colors live in
+  // separate planes, validity is a packed bitmask and every point keeps
+  // index of the depth pixel it was generated from, so consumers skip
+  // invalid points by mask instead of testing coordinates for NaN.
+  struct PointCloud
   {
-  public:
-    using PointInfoLocked =
-      std::tuple<std::unique_lock<std::mutex>, CameraShot &>;
-    using PointInfo = PointArray;
+    using Mask = uint64_t;
+    constexpr static size_t mask_bits = 64;
 
-    using MarkInfoLocked =
-      std::tuple<std::unique_lock<std::mutex>, RectArray &>;
-    using MarkInfo = RectArray;
+    // Width of the pixel grid index refers to
+    size_t width = 1;
+
+    AlignedVector<float> x, y, z;
+    AlignedVector<uint32_t> color;
+    AlignedVector<uint32_t> index;
+    AlignedVector<Mask> valid;
+
+    PointCloud() = default;
+
+    explicit PointCloud(std::pmr::memory_resource *resource)
+      : x(resource)
+      , y(resource)
+      , z(resource)
+      , color(resource)
+      , index(resource)
+      , valid(resource)
+    {}
+
+    std::pmr::memory_resource *
+    resource() const
+    {
+      return x.get_allocator().resource;
+    }
+
+    constexpr static size_t
+    mask_words(size_t n)
+    {
+      return (n + mask_bits - 1) / mask_bits;
+    }
+
+    size_t
+    size() const
+    {
+      return x.size();
+    }
+
+    bool
+    empty() const
+    {
+      return x.empty();
+    }
 
     void
-    update_cam1(PointArray &&points, size_t width)
+    clear()
     {
-      std::unique_lock lck{ this->mtx };
+      x.clear();
+      y.clear();
+      z.clear();
+      color.clear();
+      index.clear();
+      valid.clear();
+    }
 
-      this->camshot1.points = std::move(points);
-      this->camshot1.width = width;
+    void
+    reserve(size_t n)
+    {
+      x.reserve(n);
+      y.reserve(n);
+      z.reserve(n);
+      color.reserve(n);
+      index.reserve(n);
+      valid.reserve(mask_words(n));
     }
 
+    // Added points are invalid NaN points
     void
-    update_cam2(PointArray &&points, size_t width)
+    resize(size_t n)
     {
-      std::unique_lock lck{ this->mtx };
+      x.resize(n, NAN);
+      y.resize(n, NAN);
+      z.resize(n, NAN);
+      color.resize(n, WHITE.packed);
+      index.resize(n, 0);
+      valid.resize(mask_words(n), 0);
+
+      // Keep bits past the end cleared, growing relies on it
+      if (n % mask_bits)
+        valid.back() &= (Mask(1) << (n % mask_bits)) - 1;
+    }
 
-      this->camshot2.points = std::move(points);
-      this->camshot2.width = width;
+    void
+    push_back(const Point3f &p, ColorType c, uint32_t idx)
+    {
+      auto i = size();
+
+      x.push_back(p.x);
+      y.push_back(p.y);
+      z.push_back(p.z);
+      color.push_back(c.packed);
+      index.push_back(idx);
+
+      if (i % mask_bits == 0)
+        valid.push_back(0);
+
+      set_valid(i, !std::isnan(p.x));
     }
 
-    PointInfoLocked
-    get_points_cam1()
+    void
+    push_back(const Point3fc &p, uint32_t idx)
     {
-      return { std::unique_lock(this->mtx), this->camshot1 };
+      push_back(p, p.color, idx);
     }
 
-    PointInfoLocked
-    get_points_cam2()
+    bool
+    is_valid(size_t i) const
     {
-      return { std::unique_lock(this->mtx), this->camshot2 };
+      return (valid[i / mask_bits] >> (i % mask_bits)) & 1;
     }
 
-    MarkInfoLocked
-    get_marks()
+    void
+    set_valid(size_t i, bool v)
     {
-      return { std::unique_lock(this->mtx), this->marks };
+      auto bit = Mask(1) << (i % mask_bits);
+
+      if (v)
+        valid[i / mask_bits] |= bit;
+      else
+        valid[i / mask_bits] &= ~bit;
     }
 
-    PointInfo
-    get_translated_points(const CameraShot &cam)
+    size_t
+    count_valid() const
     {
-      std::unique_lock lck{ this->mtx };
-      auto ret = cam.points;
-      lck.unlock();
+      size_t count = 0;
 
-      glm::vec3 tvec = cam.tvec;
-      glm::vec3 rvec = cam.rvec;
+      for (auto m : valid)
+        count += __builtin_popcountll(m);
 
-      for (auto &point : ret)
-      {
-        point.x += tvec.x;
-        point.y += tvec.y;
-        point.z += tvec.z;
+      return count;
+    }
 
-        point = glm::rotateX(static_cast<glm::vec3>(point), rvec.x);
-        point = glm::rotateY(static_cast<glm::vec3>(point), rvec.y);
-        point = glm::rotateZ(static_cast<glm::vec3>(point), rvec.z);
+    // Valid points in [begin, end)
+    size_t
+    count_valid(size_t begin, size_t end) const
+    {
+      if (begin >= end)
+        return 0;
 
-        if (point.y <= (FLOOR_BASE_Y + cam.floor_level))
-        {
-          point.x = NAN;
-          point.y = NAN;
-          point.z = NAN;
-        }
+      auto first = begin / mask_bits, last = (end - 1) / mask_bits;
+      Mask lo = ~Mask(0) << (begin % mask_bits);
+      Mask hi = ~Mask(0) >> (mask_bits - 1 - (end - 1) % mask_bits);
+
+      if (first == last)
+        return __builtin_popcountll(valid[first] & lo & hi);
+
+      size_t count = __builtin_popcountll(valid[first] & lo) +
+                     __builtin_popcountll(valid[last] & hi);
+
+      for (auto w = first + 1; w < last; ++w)
+        count += __builtin_popcountll(valid[w]);
+
+      return count;
+    }
+
+    Point3fc
+    operator[](size_t i) const
+    {
+      ColorType c;
+      c.packed = color[i];
+
+      return { x[i], y[i], z[i], c };
+    }
+
+    void
+    set(size_t i, const Point3fc &p)
+    {
+      x[i] = p.x;
+      y[i] = p.y;
+      z[i] = p.z;
+      color[i] = p.color.packed;
+      set_valid(i, !std::isnan(p.x));
+    }
+
+    // Calls f(i) for every valid point in order. Mask word is read before
+    // its points are visited, so f may invalidate the point it gets.
+    template<typename F>
+    void
+    for_each_valid(F &&f) const
+    {
+      for (size_t w = 0; w < valid.size(); ++w)
+      {
+        for (Mask m = valid[w]; m != 0; m &= m - 1)
+          f(w * mask_bits + __builtin_ctzll(m));
       }
+    }
+
+    void
+    set_all_valid()
+    {
+      std::fill(valid.begin(), valid.end(), ~Mask(0));
+
+      if (size() % mask_bits)
+        valid.back() = (Mask(1) << (size() % mask_bits)) - 1;
+    }
+
+    // Drops invalid points in place, index still leads every point back
+    // to its pixel so the organized grid can be rebuilt on demand
+    void
+    compact()
+    {
+      size_t n = 0;
+
+      for_each_valid([&](size_t i) {
+        x[n] = x[i];
+        y[n] = y[i];
+        z[n] = z[i];
+        color[n] = color[i];
+        index[n] = index[i];
+        ++n;
+      });
+
+      resize(n);
+      set_all_valid();
+    }
+
+    // Organized copy holding one point per pixel of width x height grid
+    PointCloud
+    organize(size_t height) const
+    {
+      PointCloud ret;
+
+      ret.width = width;
+      ret.resize(width * height);
+
+      for (size_t j = 0; j < ret.size(); ++j)
+        ret.index[j] = j;
+
+      for_each_valid([&](size_t i) {
+        auto j = index[i];
+
+        ret.x[j] = x[i];
+        ret.y[j] = y[i];
+        ret.z[j] = z[i];
+        ret.color[j] = color[i];
+        ret.set_valid(j, true);
+      });
 
       return ret;
     }
 
-    PointInfo
-    get_translated_points_cam1()
+    // Invalid points are emitted as NaN points
+    std::vector<Point3fc>
+    to_point_array() const
     {
-      return this->get_translated_points(this->camshot1);
+      std::vector<Point3fc> ret(size(), Point3fc{ NAN, NAN, NAN, WHITE });
+
+      for_each_valid([&](size_t i) { ret[i] = (*this)[i]; });
+
+      return ret;
     }
 
-    PointInfo
-    get_translated_points_cam2()
+    // Points are assumed to be in row major pixel order of given width
+    template<typename PointType>
+    static PointCloud
+    from_point_array(const std::vector<PointType> &points, size_t width)
     {
-      return this->get_translated_points(this->camshot2);
+      PointCloud ret;
+
+      ret.width = width;
+      ret.reserve(points.size());
+
+      for (size_t i = 0; i < points.size(); ++i)
+        ret.push_back(Point3fc(points[i]), i);
+
+      return ret;
     }
+  };
 
-    glm::vec3
-    get_tvec_cam1()
+  // Rigid transform as a single 3x4 matrix, rotation in the first three
+  // columns and translation in the last one
+  using RigidTransform = glm::mat4x3;
+
+  inline RigidTransform
+  make_transform(const glm::mat3x3 &rot, glm::vec3 t)
+  {
+    return RigidTransform(rot[0], rot[1], rot[2], t);
+  }
+
+  // Transform equal to applying b first and then a
+  inline RigidTransform
+  compose_transform(const RigidTransform &a, const RigidTransform &b)
+  {
+    glm::mat3x3 ra(a[0], a[1], a[2]);
+    glm::mat3x3 rb(b[0], b[1], b[2]);
+
+    return make_transform(ra * rb, ra * b[3] + a[3]);
+  }
+
+  // Pose used by the 3d view: translate by tvec, then rotate around X, Y
+  // and Z axis in that order
+  inline RigidTransform
+  pose_transform(glm::vec3 tvec, glm::vec3 rvec)
+  {
+    glm::mat3x3 rot(1.0f);
+
+    for (int i = 0; i < 3; ++i)
     {
-      std::unique_lock lck{ this->mtx };
-      return this->camshot1.tvec;
+      rot[i] = glm::rotateX(rot[i], rvec.x);
+      rot[i] = glm::rotateY(rot[i], rvec.y);
+      rot[i] = glm::rotateZ(rot[i], rvec.z);
     }
 
-    glm::vec3
-    get_rvec_cam1()
+    return make_transform(rot, rot * tvec);
+  }
+
+  template<typename PointType>
+  inline PointType &
+  apply_transform(const RigidTransform &m, PointType &p)
+  {
+    const float x = p.x, y = p.y, z = p.z;
+
+    p.x = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0];
+    p.y = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1];
+    p.z = m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2];
+
+    return p;
+  }
+
+  // Batch version, matrix is kept in registers so every point costs
+  // 9 multiply-adds. NaN points stay NaN.
+  template<typename PointType>
+  inline void
+  apply_transform(const RigidTransform &m, std::vector<PointType> &points)
+  {
+    const float m00 = m[0][0], m10 = m[1][0], m20 = m[2][0], m30 = m[3][0];
+    const float m01 = m[0][1], m11 = m[1][1], m21 = m[2][1], m31 = m[3][1];
+    const float m02 = m[0][2], m12 = m[1][2], m22 = m[2][2], m32 = m[3][2];
+
+    for (auto &p : points)
     {
-      std::unique_lock lck{ this->mtx };
-      return this->camshot1.rvec;
+      const float x = p.x, y = p.y, z = p.z;
+
+      p.x = m00 * x + m10 * y + m20 * z + m30;
+      p.y = m01 * x + m11 * y + m21 * z + m31;
+      p.z = m02 * x + m12 * y + m22 * z + m32;
     }
+  }
+
+  // Plane version over points [begin, end), branch free including
+  // invalid points so disjoint ranges can run on separate threads
+  inline void
+  apply_transform(const RigidTransform &m,
+                  PointCloud &cloud,
+                  size_t begin,
+                  size_t end)
+  {
+    const float m00 = m[0][0], m10 = m[1][0], m20 = m[2][0], m30 = m[3][0];
+    const float m01 = m[0][1], m11 = m[1][1], m21 = m[2][1], m31 = m[3][1];
+    const float m02 = m[0][2], m12 = m[1][2], m22 = m[2][2], m32 = m[3][2];
 
-    glm::vec3
-    get_tvec_cam2()
+    float *__restrict px = cloud.x.data() + begin;
+    float *__restrict py = cloud.y.data() + begin;
+    float *__restrict pz = cloud.z.data() + begin;
+    const size_t n = end - begin;
+
+    for (size_t i = 0; i < n; ++i)
     {
-      std::unique_lock lck{ this->mtx };
-      return this->camshot2.tvec;
+      const float x = px[i], y = py[i], z = pz[i];
+
+      px[i] = m00 * x + m10 * y + m20 * z + m30;
+      py[i] = m01 * x + m11 * y + m21 * z + m31;
+      pz[i] = m02 * x + m12 * y + m22 * z + m32;
     }
+  }
 
-    glm::vec3
-    get_rvec_cam2()
+  inline void
+  apply_transform(const RigidTransform &m, PointCloud &cloud)
+  {
+    apply_transform(m, cloud, 0, cloud.size());
+  }
+
+  // Points at or below the floor are marked invalid
+  inline void
+  clip_floor(PointCloud &cloud, float floor_level)
+  {
+    const float floor_y = FLOOR_BASE_Y + floor_level;
+
+    cloud.for_each_valid([&](size_t i) {
+      if (cloud.y[i] <= floor_y)
+        cloud.set_valid(i, false);
+    });
+  }
+
+  // Points at or below the floor are replaced with NaN
+  template<typename PointType>
+  inline void
+  clip_floor(std::vector<PointType> &points, float floor_level)
+  {
+    const float floor_y = FLOOR_BASE_Y + floor_level;
+
+    for (auto &p : points)
+    {
+      if (p.y <= floor_y)
+      {
+        p.x = NAN;
+        p.y = NAN;
+        p.z = NAN;
+      }
+    }
+  }
+
+  // State of one camera. Published shots are immutable, every change
+  // publishes a new shot sharing the unchanged point cloud.
+  struct CameraShot
+  {
+    // Posed and floor clipped copy of points, built by the first reader
+    struct WorldCache
+    {
+      std::once_flag once;
+      PointCloud cloud;
+    };
+
+    std::shared_ptr<const PointCloud> points =
+      std::make_shared<const PointCloud>(
+        PointCloud::from_point_array(PointArray{ { 0, 0, 0, WHITE } }, 1));
+    glm::vec3 tvec{ 0.0f, 0.0f, 0.0f };
+    glm::vec3 rvec{ 0.0f, 0.0f, 0.0f };
+    float floor_level = 0.0f;
+    std::shared_ptr<WorldCache> world = std::make_shared<WorldCache>();
+
+    const PointCloud &
+    world_points() const
+    {
+      std::call_once(world->once, [this] {
+        world->cloud = *points;
+        apply_transform(pose_transform(tvec, rvec), world->cloud);
+        clip_floor(world->cloud, floor_level);
+      });
+
+      return world->cloud;
+    }
+  };
+
+  // Shared scene of the processing and render threads, one shot per
+  // camera id. Readers load the current snapshot with an atomic
+  // shared_ptr load and keep it as long as they like, writers copy the
+  // shot, modify the copy and swap in a new array of shots. Writers
+  // serialize among themselves, readers never wait for them.
+  struct Context3D
+  {
+  public:
+    using ShotPtr = std::shared_ptr<const CameraShot>;
+    using Shots = std::vector<ShotPtr>;
+    using ShotsPtr = std::shared_ptr<const Shots>;
+    // Keeps its shot alive, so the view stays valid after republishing
+    using PointInfo = std::shared_ptr<const PointCloud>;
+    using MarkInfo = RectArray;
+    using MarksPtr = std::shared_ptr<const RectArray>;
+
+    explicit Context3D(size_t cameras = 2)
     {
-      std::unique_lock lck{ this->mtx };
-      return this->camshot2.rvec;
+      set_camera_count(cameras);
     }
 
+    // New cameras start with an empty shot, removed ones are dropped
     void
-    set_tvec_cam1(glm::vec3 v)
+    set_camera_count(size_t cameras)
+    {
+      std::unique_lock lck{ this->write_mtx };
+      auto next = std::make_shared<Shots>(*get_shots());
+      auto floor_level = next->empty() ? 0.0f : next->front()->floor_level;
+
+      next->resize(cameras);
+      for (auto &shot : *next)
+      {
+        if (!shot)
+        {
+          auto empty = std::make_shared<CameraShot>();
+          empty->floor_level = floor_level;
+          shot = std::move(empty);
+        }
+      }
+      std::atomic_store(&this->shots, ShotsPtr(std::move(next)));
+    }
+
+    size_t
+    get_camera_count() const
     {
-      std::unique_lock lck{ this->mtx };
-      this->camshot1.tvec = v;
+      return get_shots()->size();
     }
 
     void
-    set_rvec_cam1(glm::vec3 v)
+    update(size_t cam, PointCloud &&points)
     {
-      std::unique_lock lck{ this->mtx };
-      this->camshot1.rvec = v;
+      // cloud is moved to the heap before the writer lock is taken. The
+      // snapshot takes the default resource, planes of an arena cloud
+      // are copied out instead of stolen, as a copy would do.
+      auto cloud = std::make_shared<PointCloud>();
+      *cloud = std::move(points);
+
+      modify(cam, [&](CameraShot &cs) { cs.points = std::move(cloud); });
     }
 
     void
-    set_tvec_cam2(glm::vec3 v)
+    update(size_t cam, const PointCloud &points)
     {
-      std::unique_lock lck{ this->mtx };
-      this->camshot2.tvec = v;
+      update(cam, PointCloud(points));
     }
 
+    // Shots of all cameras published together
+    ShotsPtr
+    get_shots() const
+    {
+      return std::atomic_load(&this->shots);
+    }
+
+    ShotPtr
+    get_shot(size_t cam) const
+    {
+      auto all = get_shots();
+      assert(cam < all->size());
+
+      return (*all)[cam];
+    }
+
+    MarksPtr
+    get_marks() const
+    {
+      return std::atomic_load(&this->marks);
+    }
+
+    // Applies f to a copy of the current shot and publishes the copy
+    template<typename F>
     void
-    set_rvec_cam2(glm::vec3 v)
+    modify(size_t cam, F &&f)
+    {
+      std::unique_lock lck{ this->write_mtx };
+      auto next = std::make_shared<Shots>(*get_shots());
+      assert(cam < next->size());
+
+      publish((*next)[cam], f);
+      std::atomic_store(&this->shots, ShotsPtr(std::move(next)));
+    }
+
+    // World space points of a shot, computed once per published shot
+    static PointInfo
+    get_translated_points(const ShotPtr &shot)
     {
-      std::unique_lock lck{ this->mtx };
-      this->camshot2.rvec = v;
+      return PointInfo(shot, &shot->world_points());
+    }
+
+    PointInfo
+    get_translated_points(size_t cam) const
+    {
+      return get_translated_points(get_shot(cam));
+    }
+
+    glm::vec3
+    get_tvec(size_t cam) const
+    {
+      return get_shot(cam)->tvec;
+    }
+
+    glm::vec3
+    get_rvec(size_t cam) const
+    {
+      return get_shot(cam)->rvec;
+    }
+
+    void
+    set_tvec(size_t cam, glm::vec3 v)
+    {
+      modify(cam, [&](CameraShot &cs) { cs.tvec = v; });
     }
 
+    void
+    set_rvec(size_t cam, glm::vec3 v)
+    {
+      modify(cam, [&](CameraShot &cs) { cs.rvec = v; });
+    }
+
+    // Every camera sees the same floor, all shots are swapped at once
     void
     set_floor_level(float level)
     {
-      std::unique_lock lck{ this->mtx };
-      this->camshot1.floor_level = level;
-      this->camshot2.floor_level = level;
+      std::unique_lock lck{ this->write_mtx };
+      auto next = std::make_shared<Shots>(*get_shots());
+      auto set = [&](CameraShot &cs) { cs.floor_level = level; };
+
+      for (auto &shot : *next)
+        publish(shot, set);
+      std::atomic_store(&this->shots, ShotsPtr(std::move(next)));
     }
 
     float
     get_floor_level() const
     {
-      std::unique_lock lck{ this->mtx };
-      assert(this->camshot1.floor_level == this->camshot2.floor_level);
-
-      return this->camshot1.floor_level;
+      return get_shot(0)->floor_level;
     }
 
     void
     mark(Rectfc rect, glm::vec3 tvec, glm::vec3 rvec)
     {
-      std::unique_lock lck{ this->mtx };
+      auto pose = pose_transform(tvec, rvec);
 
-      for (auto &v : rect.verts) {
-        v += tvec;
+      for (auto &v : rect.verts)
+        apply_transform(pose, v);
 
-        v = glm::rotateX(static_cast<glm::vec3>(v), rvec.x);
-        v = glm::rotateY(static_cast<glm::vec3>(v), rvec.y);
-        v = glm::rotateZ(static_cast<glm::vec3>(v), rvec.z);
-      }
+      std::unique_lock lck{ this->write_mtx };
+      auto next = std::make_shared<RectArray>(*std::atomic_load(&marks));
 
-      marks.emplace_back(std::move(rect));
+      next->emplace_back(std::move(rect));
+      std::atomic_store(&this->marks, MarksPtr(std::move(next)));
     }
 
     void
     reset_marks()
     {
-      std::unique_lock lck{ this->mtx };
-      marks.clear();
+      std::unique_lock lck{ this->write_mtx };
+      std::atomic_store(&this->marks, std::make_shared<const RectArray>());
     }
 
   private:
-    mutable std::mutex mtx;
-    CameraShot camshot1, camshot2;
-    RectArray marks;
+    // Replaces shot with a modified copy, caller holds write_mtx
+    template<typename F>
+    static void
+    publish(ShotPtr &shot, F &f)
+    {
+      auto next = std::make_shared<CameraShot>(*shot);
+
+      f(*next);
+      next->world = std::make_shared<CameraShot::WorldCache>();
+      shot = std::move(next);
+    }
+
+    std::mutex write_mtx;
+    ShotsPtr shots = std::make_shared<const Shots>();
+    MarksPtr marks = std::make_shared<const RectArray>();
   };
 
 } // namespace farsight
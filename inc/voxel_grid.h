@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "types.h"
+
+namespace farsight {
+
+  enum class VoxelSelect
+  {
+    CENTROID, // average of all points falling into voxel
+    FIRST     // first point that hit the voxel
+  };
+
+  struct VoxelGridParams
+  {
+    // Voxel edge in meters, downsampling is off for non positive values
+    float leaf_size = 0.0f;
+    VoxelSelect select = VoxelSelect::CENTROID;
+  };
+
+  inline int64_t
+  voxel_coord(float v, float inv_leaf)
+  {
+    return static_cast<int64_t>(std::floor(v * inv_leaf));
+  }
+
+  // 21 bits per axis is enough for +-10km with 1cm voxels
+  inline uint64_t
+  voxel_key(int64_t vx, int64_t vy, int64_t vz)
+  {
+    constexpr int64_t bias = 1 << 20;
+    constexpr uint64_t mask = (1 << 21) - 1;
+
+    return (static_cast<uint64_t>(vx + bias) & mask) |
+           ((static_cast<uint64_t>(vy + bias) & mask) << 21) |
+           ((static_cast<uint64_t>(vz + bias) & mask) << 42);
+  }
+
+  inline uint64_t
+  voxel_key(float x, float y, float z, float inv_leaf)
+  {
+    return voxel_key(voxel_coord(x, inv_leaf),
+                     voxel_coord(y, inv_leaf),
+                     voxel_coord(z, inv_leaf));
+  }
+
+  // Keeps one point per occupied voxel. Single pass over valid points
+  // with voxels looked up in a hash map, output is compact and every
+  // point keeps pixel index and color of the first point of its voxel.
+  PointCloud
+  voxel_downsample(
+    const PointCloud &cloud,
+    const VoxelGridParams &params,
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+} // namespace farsight
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace farsight {
+
+  // Fixed set of threads running data parallel loops. The calling thread
+  // works on bands as well, so a pool of N workers runs N + 1 bands at once.
+  class WorkerPool
+  {
+  public:
+    explicit WorkerPool(size_t workers);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &
+    operator=(const WorkerPool &) = delete;
+
+    size_t
+    get_concurrency() const
+    {
+      return threads.size() + 1;
+    }
+
+    // Splits [begin, end) into one band per thread and calls fn(b, e) for
+    // every band, returns once all bands are done. Band boundaries other
+    // than begin and end are multiples of grain, so bands never share a
+    // word of PointCloud validity mask when grain is PointCloud::mask_bits.
+    // Callers on different threads take turns, one job runs at a time. A
+    // call from inside a band runs its whole range inline.
+    template<typename F>
+    void
+    parallel_for(size_t begin, size_t end, size_t grain, F &&fn)
+    {
+      using Fn = std::remove_reference_t<F>;
+
+      run(
+        begin,
+        end,
+        grain,
+        [](void *ctx, size_t b, size_t e) { (*static_cast<Fn *>(ctx))(b, e); },
+        const_cast<void *>(static_cast<const void *>(&fn)));
+    }
+
+  private:
+    using BandFn = void (*)(void *, size_t, size_t);
+
+    void
+    run(size_t begin, size_t end, size_t grain, BandFn fn, void *ctx);
+
+    void
+    work(BandFn fn, void *ctx);
+
+    void
+    worker();
+
+    std::vector<std::thread> threads;
+    // Held by the calling thread for a whole job
+    std::mutex caller;
+    std::mutex mtx;
+    std::condition_variable wake, done;
+    size_t generation = 0;
+    size_t active = 0;
+    bool stop = false;
+
+    // Current job, written only while no worker is active
+    BandFn job_fn = nullptr;
+    void *job_ctx = nullptr;
+    size_t job_begin = 0, job_end = 0, job_base = 0, band_size = 0;
+    size_t band_count = 0;
+    std::atomic<size_t> next_band = 0;
+    std::atomic<size_t> pending = 0;
+  };
+
+  // Pool shared by the whole pipeline, one thread per core
+  WorkerPool &
+  worker_pool();
+
+} // namespace farsight
@@ -1,6 +1,10 @@
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <chrono>
 #include <cmath>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include <fcntl.h>
@@ -18,6 +22,8 @@
 #include <glm/gtx/rotate_vector.hpp>
 
 #include "camera.h"
+#include "point_renderer.h"
+#include "scene.h"
 #include "types.h"
 #include "utils.h"
 
@@ -54,135 +60,98 @@ namespace farsight {
 
   static GLfloat offset_x = 0;
   static GLfloat offset_y = 0;
+  static size_t edited_camera_id = 0;
+  // Never destroyed, its GL objects go with the context at exit. Static
+  // destruction runs on the main thread without a current context while
+  // the glut thread may still be drawing.
+  static PointRenderer &renderer = *new PointRenderer;
+
+  // Redraws happen only on timer ticks, so the frame rate never exceeds
+  // frame_period_ms. Input asks for a redraw, new snapshots of Context3D
+  // are noticed by the tick itself.
+  constexpr static int frame_period_ms = 1000 / 60;
+  static bool redraw_requested = true;
+  static bool show_stats = true;
+  static double frame_ms = 0;
+  static Context3D::ShotsPtr drawn_shots;
+  static Context3D::MarksPtr drawn_marks;
   Context3D context3D;
 
   static void
-  Axes(void)
+  drawtext(int x, int y, const std::string &text)
   {
-    vec3 x_min = { -50.0, 0.0, 0.0 };
-    vec3 x_max = { 50.0, 0.0, 0.0 };
-
-    vec3 y_min = { 0.0, -50.0, 0.0 };
-    vec3 y_max = { 0.0, 50.0, 0.0 };
-
-    vec3 z_min = { 0.0, 0.0, -50.0 };
-    vec3 z_max = { 0.0, 0.0, 50.0 };
-
-    glColor3f(1.0f, 0.0f, 0.0f);
-    glBegin(GL_LINES);
-
-    glVertex3fv(value_ptr(x_min));
-    glVertex3fv(value_ptr(x_max));
-
-    glEnd();
-
-    glColor3f(0.0f, 0.5f, 0.0f);
-    glBegin(GL_LINES);
-    glVertex3fv(value_ptr(y_min));
-    glVertex3f(0, 0, 0);
-    glEnd();
-
-    glColor3f(0.0f, 1.0f, 0.0f);
-    glBegin(GL_LINES);
-    glVertex3fv(value_ptr(y_max));
-    glVertex3f(0, 0, 0);
-    glEnd();
-
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glBegin(GL_LINES);
-
-    glVertex3fv(value_ptr(z_min));
-    glVertex3fv(value_ptr(z_max));
-
-    glEnd();
+    glRasterPos2i(x, y);
+    for (char c : text)
+      glutBitmapCharacter(GLUT_BITMAP_8_BY_13, c);
   }
 
+  // Overlay in viewport pixels, values of the previous frame
   static void
-  drawpoints(const CameraShot &cs)
+  drawstats()
   {
-    float max_x = std::numeric_limits<float>::min(),
-          max_y = std::numeric_limits<float>::min(),
-          max_z = std::numeric_limits<float>::min(),
-          min_x = std::numeric_limits<float>::max(),
-          min_y = std::numeric_limits<float>::max(),
-          min_z = std::numeric_limits<float>::max();
-
-    glBegin(GL_POINTS);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
 
-    for (auto &p_ : cs.points)
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, viewport[2], 0, viewport[3]);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+
+    auto cam = edited_camera_id;
+    const auto &shot = *(*drawn_shots)[cam];
+    int y = viewport[3] - 15;
+
+    glColor3f(1.0f, 1.0f, 0.0f);
+    drawtext(5, y, fmt::format("frame {:.2f} ms", frame_ms));
+    drawtext(5,
+             y -= 15,
+             fmt::format("upload {:.2f} ms", renderer.get_upload_ms()));
+    drawtext(5,
+             y -= 15,
+             fmt::format("points {} detail {:.0f}%",
+                         renderer.get_point_count(),
+                         renderer.get_detail() * 100));
+    drawtext(5,
+             y -= 15,
+             fmt::format("CAM{} TVEC {:.3f} {:.3f} {:.3f}",
+                         cam + 1,
+                         shot.tvec.x,
+                         shot.tvec.y,
+                         shot.tvec.z));
+    drawtext(5,
+             y -= 15,
+             fmt::format("CAM{} ROT {:.3f} {:.3f} {:.3f}",
+                         cam + 1,
+                         shot.rvec.x,
+                         shot.rvec.y,
+                         shot.rvec.z));
+
+    if (!renderer.get_program_log().empty())
     {
-      glm::vec3 p = p_;
-      auto color = p_.color;
-
-      if (unlikely(std::isnan(p.z)))
-        continue;
-
-      p.x += cs.tvec.x;
-      p.y += cs.tvec.y;
-      p.z += cs.tvec.z;
-
-      p = glm::rotateX(p, cs.rvec.x);
-      p = glm::rotateY(p, cs.rvec.y);
-      p = glm::rotateZ(p, cs.rvec.z);
-
-      if (p.y <= (FLOOR_BASE_Y + cs.floor_level))
-        continue;
-
-      glColor3ub(color.r, color.g, color.b);
-      glVertex3f(p.x, p.y, p.z);
-
-      max_x = std::max(max_x, p.x);
-      max_y = std::max(max_y, p.y);
-      max_z = std::max(max_z, p.z);
-
-      min_x = std::min(min_x, p.x);
-      min_y = std::min(min_y, p.y);
-      min_z = std::min(min_z, p.z);
+      glColor3f(1.0f, 0.0f, 0.0f);
+      drawtext(5, y -= 15, renderer.get_program_log());
     }
 
-    fmt::print("Drawing points: \n"
-               "\t max_x {}\n"
-               "\t max_y {}\n"
-               "\t max_z {}\n"
-               "\t min_x {}\n"
-               "\t min_y {}\n"
-               "\t min_z {}\n",
-               max_x,
-               max_y,
-               max_z,
-               min_x,
-               min_y,
-               min_z);
-
-    glEnd();
-  }
-
-  static void
-  drawmarks(const RectArray &marks)
-  {
-    using VertType = decltype(marks[0].verts);
-
-    for (auto &m : marks)
-    {
-      glBegin(GL_LINE_LOOP);
-
-      VertType verts;
-      std::copy(std::begin(m.verts), std::end(m.verts), std::begin(verts));
-
-      auto color = m.color;
-
-      for (auto &v : verts) {
-        glColor3ub(color.r, color.g, color.b);
-        glVertex3f(v.x, v.y, v.z);
-      }
-
-      glEnd();
-    }
+    glEnable(GL_DEPTH_TEST);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
   }
 
   void
   RenderScene()
   {
+    auto start = std::chrono::steady_clock::now();
+
+    // snapshots stay alive while drawing, writers publish new ones
+    drawn_shots = context3D.get_shots();
+    drawn_marks = context3D.get_marks();
+    edited_camera_id = std::min(edited_camera_id, drawn_shots->size() - 1);
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
@@ -196,25 +165,29 @@ namespace farsight {
               viewer_up[0],
               viewer_up[1],
               viewer_up[2]);
-    Axes();
+    draw_scene(renderer, *drawn_shots, *drawn_marks);
 
-    {
-      auto [lck, cs] = context3D.get_points_cam1();
-      drawpoints(cs);
-    }
-
-    {
-      auto [lck, cs] = context3D.get_points_cam2();
-      drawpoints(cs);
-    }
-
-    {
-      auto [lck, marks] = context3D.get_marks();
-      drawmarks(marks);
-    }
+    if (show_stats)
+      drawstats();
 
     glFlush();
     glutSwapBuffers();
+
+    redraw_requested = false;
+    frame_ms = std::chrono::duration<double, std::milli>(
+                 std::chrono::steady_clock::now() - start)
+                 .count();
+    renderer.report_frame(frame_ms);
+  }
+
+  static void
+  Tick(int)
+  {
+    if (redraw_requested || context3D.get_shots() != drawn_shots ||
+        context3D.get_marks() != drawn_marks)
+      glutPostRedisplay();
+
+    glutTimerFunc(frame_period_ms, Tick, 0);
   }
 
   static void
@@ -284,7 +257,16 @@ namespace farsight {
     update_lookat();
     update_viewer_up();
 
-    glutPostRedisplay();
+    redraw_requested = true;
+  }
+
+  // Camera moved by the keyboard, the next one with shift
+  static size_t
+  edited_camera(bool next)
+  {
+    auto count = context3D.get_camera_count();
+
+    return (edited_camera_id + next) % count;
   }
 
   static void
@@ -357,131 +339,96 @@ namespace farsight {
         break;
       }
 
+      // lowercase keys move the edited camera, uppercase the one after it
       case 'h':
       case 'j':
       case 'k':
       case 'l':
       case 'f':
-      case 'g': {
-        auto [lck, cs] = context3D.get_points_cam1();
-
-        switch (key)
-        {
-          case 'h':
-            cs.tvec.x -= tspeed;
-            break;
-          case 'l':
-            cs.tvec.x += tspeed;
-            break;
-
-          case 'j':
-            cs.tvec.y += tspeed;
-            break;
-          case 'k':
-            cs.tvec.y -= tspeed;
-            break;
-
-          case 'f':
-            cs.tvec.z += tspeed;
-            break;
-          case 'g':
-            cs.tvec.z -= tspeed;
-            break;
-        }
-
-        fmt::print(
-          "CAM1 TVEC: {} {} {}\n", cs.tvec.x, cs.tvec.y, cs.tvec.z);
-        break;
-      }
-
+      case 'g':
       case 'H':
       case 'J':
       case 'K':
       case 'L':
       case 'F':
       case 'G': {
-        auto [lck, cs] = context3D.get_points_cam2();
-
-        switch (key)
-        {
-          case 'H':
-            cs.tvec.x -= tspeed;
-            break;
-          case 'L':
-            cs.tvec.x += tspeed;
-            break;
-
-          case 'J':
-            cs.tvec.y += tspeed;
-            break;
-          case 'K':
-            cs.tvec.y -= tspeed;
-            break;
-
-          case 'F':
-            cs.tvec.z += tspeed;
-            break;
-          case 'G':
-            cs.tvec.z -= tspeed;
-            break;
-        }
-
-        fmt::print(
-          "CAM2 TVEC: {} {} {}\n", cs.tvec.x, cs.tvec.y, cs.tvec.z);
+        auto cam = edited_camera(std::isupper(key));
+
+        context3D.modify(cam, [&](CameraShot &cs) {
+          switch (std::tolower(key))
+          {
+            case 'h':
+              cs.tvec.x -= tspeed;
+              break;
+            case 'l':
+              cs.tvec.x += tspeed;
+              break;
+
+            case 'j':
+              cs.tvec.y += tspeed;
+              break;
+            case 'k':
+              cs.tvec.y -= tspeed;
+              break;
+
+            case 'f':
+              cs.tvec.z += tspeed;
+              break;
+            case 'g':
+              cs.tvec.z -= tspeed;
+              break;
+          }
+        });
         break;
       }
 
       case 'x':
       case 'y':
-      case 'z': {
-        auto [lck, cs] = context3D.get_points_cam1();
-
-        switch (key)
-        {
-          case 'x':
-            cs.rvec.x += rotangle;
-            break;
-          case 'y':
-            cs.rvec.y += rotangle;
-            break;
-          case 'z':
-            cs.rvec.z += rotangle;
-            break;
-        }
-
-        fmt::print(
-          "CAM1 ROT: {} {} {}\n", cs.rvec.x, cs.rvec.y, cs.rvec.z);
-        break;
-      }
-
+      case 'z':
       case 'X':
       case 'Y':
       case 'Z': {
-        auto [lck, cs] = context3D.get_points_cam2();
-
-        switch (key)
-        {
-          case 'X':
-            cs.rvec.x += rotangle;
-            break;
-          case 'Y':
-            cs.rvec.y += rotangle;
-            break;
-          case 'Z':
-            cs.rvec.z += rotangle;
-            break;
-        }
-
-        fmt::print(
-          "CAM1 ROT: {} {} {}\n", cs.rvec.x, cs.rvec.y, cs.rvec.z);
+        auto cam = edited_camera(std::isupper(key));
+
+        context3D.modify(cam, [&](CameraShot &cs) {
+          switch (std::tolower(key))
+          {
+            case 'x':
+              cs.rvec.x += rotangle;
+              break;
+            case 'y':
+              cs.rvec.y += rotangle;
+              break;
+            case 'z':
+              cs.rvec.z += rotangle;
+              break;
+          }
+        });
         break;
       }
 
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+        if (size_t(key - '1') < context3D.get_camera_count())
+          edited_camera_id = key - '1';
+        break;
+
+      case 'i':
+        show_stats = !show_stats;
+        break;
+
       default:
         break;
     }
 
-    RenderScene();
+    redraw_requested = true;
   }
 
   void
@@ -503,6 +450,8 @@ namespace farsight {
     glutPassiveMotionFunc(Motion);
     glutKeyboardFunc(Keyboard);
     glutSetCursor(GLUT_CURSOR_NONE);
+    renderer.set_frame_target(frame_period_ms);
+    glutTimerFunc(frame_period_ms, Tick, 0);
     glutMainLoop();
   }
 } // namespace farsight
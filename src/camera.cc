@@ -97,11 +97,8 @@ namespace farsight {
     return faces_rotation[id];
   }
 
-  void
-  camera2real(PointArray &points,
-              glm::vec3 tvec,
-              glm::mat3x3 rot,
-              int id)
+  RigidTransform
+  camera_transform(glm::vec3 tvec, glm::mat3x3 rot, int id)
   {
     check_face_id(id);
 
@@ -119,16 +116,32 @@ namespace farsight {
     // Fix badly printed aruco?
     rot = rot * rotmat(Axis::Z, -(M_TAU / 4.0f));
 
-    // Apply camera offset and rotation to all points.
-    for (auto &point : points) {
-      point += camera_pos;
+    // Found marker rotation followed by marker relative rotation, applied
+    // after moving points by camera offset
+    glm::mat3x3 face_rot = calculate_face_rotation(id) * rot;
+
+    return make_transform(face_rot, face_rot * camera_pos);
+  }
 
-      // Apply found maker rotation
-      point = rot * point;
+  void
+  camera2real(PointCloud &points,
+              glm::vec3 tvec,
+              glm::mat3x3 rot,
+              int id,
+              WorkerPool *pool)
+  {
+    auto transform = camera_transform(tvec, rot, id);
 
-      // Apply marker relative rotation
-      point = calculate_face_rotation(id) * point;
+    if (!pool)
+    {
+      apply_transform(transform, points);
+      return;
     }
+
+    pool->parallel_for(
+      0, points.size(), PointCloud::mask_bits, [&](size_t b, size_t e) {
+        apply_transform(transform, points, b, e);
+      });
   }
 
 } // namespace farsight
@@ -0,0 +1,132 @@
+#include <cstdio>
+
+#include <fmt/format.h>
+
+#include "cloud_dump.h"
+
+namespace farsight {
+
+  CloudDumper::CloudDumper(size_t max_queue)
+    : max_queue(max_queue)
+  {
+  }
+
+  CloudDumper::~CloudDumper()
+  {
+    {
+      std::unique_lock lck{ mtx };
+      stop = true;
+    }
+    queued.notify_one();
+
+    if (thread.joinable())
+      thread.join();
+  }
+
+  bool
+  CloudDumper::dump(std::string path, std::vector<CloudPtr> clouds)
+  {
+    if (!enabled)
+      return false;
+
+    {
+      std::unique_lock lck{ mtx };
+      if (jobs.size() >= max_queue)
+      {
+        dropped++;
+        return false;
+      }
+
+      // started by the first dump, a disabled dumper never has a thread
+      if (!thread.joinable())
+        thread = std::thread(&CloudDumper::writer, this);
+
+      jobs.push_back({ std::move(path), std::move(clouds) });
+    }
+    queued.notify_one();
+
+    return true;
+  }
+
+  void
+  CloudDumper::writer()
+  {
+    std::unique_lock lck{ mtx };
+
+    while (true)
+    {
+      queued.wait(lck, [&] { return stop || !jobs.empty(); });
+      if (jobs.empty())
+        return;
+
+      auto job = std::move(jobs.front());
+      jobs.pop_front();
+
+      lck.unlock();
+      if (write_ply(job.path, job.clouds))
+        written++;
+      else
+        fmt::print(stderr, "Cannot write {}\n", job.path);
+      // handles are released before the lock is taken again
+      job.clouds.clear();
+      lck.lock();
+    }
+  }
+
+  bool
+  write_ply(const std::string &path,
+            const std::vector<CloudDumper::CloudPtr> &clouds)
+  {
+    size_t count = 0;
+    for (const auto &cloud : clouds)
+      count += cloud->count_valid();
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+      return false;
+
+    // every platform the pipeline runs on is little endian
+    auto header = fmt::format("ply\n"
+                              "format binary_little_endian 1.0\n"
+                              "element vertex {}\n"
+                              "property float x\n"
+                              "property float y\n"
+                              "property float z\n"
+                              "end_header\n",
+                              count);
+    fwrite(header.data(), 1, header.size(), file);
+
+    // points go out in blocks, one fwrite per block instead of per value
+    constexpr size_t block = 4096;
+    std::vector<float> buffer;
+    buffer.reserve(3 * block);
+
+    for (const auto &cloud : clouds)
+    {
+      cloud->for_each_valid([&](size_t i) {
+        buffer.push_back(cloud->x[i] * 1000);
+        buffer.push_back(cloud->y[i] * 1000);
+        buffer.push_back(cloud->z[i] * 1000);
+
+        if (buffer.size() == 3 * block)
+        {
+          fwrite(buffer.data(), sizeof(float), buffer.size(), file);
+          buffer.clear();
+        }
+      });
+    }
+    fwrite(buffer.data(), sizeof(float), buffer.size(), file);
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+  }
+
+  CloudDumper &
+  cloud_dumper()
+  {
+    static CloudDumper dumper;
+
+    return dumper;
+  }
+
+} // namespace farsight
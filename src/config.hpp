@@ -3,4 +3,3 @@ constexpr size_t color_width = 1920, color_height = 1080;
 constexpr size_t depth_width = 512, depth_height = 424;
 constexpr size_t total_size_depth = depth_width * depth_height;
 constexpr double cubeWidth = 50.0f;
-constexpr int maxKinectCount = 2;
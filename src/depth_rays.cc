@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "depth_rays.h"
+
+namespace farsight {
+
+  void
+  DepthRays::rebuild(const IrParams &params, size_t width, size_t height)
+  {
+    this->width = width;
+    this->height = height;
+
+    ray_x.resize(width * height);
+    ray_y.resize(width * height);
+
+    // Same pixel center convention as Registration::getPointXYZ
+    for (size_t r = 0; r < height; ++r)
+    {
+      for (size_t c = 0; c < width; ++c)
+      {
+        ray_x[r * width + c] = (c + 0.5 - params.cx) / params.fx;
+        ray_y[r * width + c] = (r + 0.5 - params.cy) / params.fy;
+      }
+    }
+  }
+
+  void
+  DepthRays::project(const float *depth,
+                     size_t x,
+                     size_t y,
+                     size_t w,
+                     size_t h,
+                     PointCloud &out,
+                     float max_z,
+                     WorkerPool *pool) const
+  {
+    assert(ready());
+    assert(x + w <= width && y + h <= height);
+
+    auto begin = out.size();
+    out.width = width;
+    out.resize(begin + w * h);
+
+    auto band = [&](size_t first, size_t last) {
+      project_range(depth, x, y, w, begin, first, last, out, max_z);
+    };
+
+    if (pool)
+      pool->parallel_for(begin, out.size(), PointCloud::mask_bits, band);
+    else
+      band(begin, out.size());
+  }
+
+  void
+  DepthRays::project_range(const float *depth,
+                           size_t x,
+                           size_t y,
+                           size_t w,
+                           size_t begin,
+                           size_t first,
+                           size_t last,
+                           PointCloud &out,
+                           float max_z) const
+  {
+    for (size_t i = first; i < last;)
+    {
+      // Longest run of output points lying on one pixel row
+      const auto k = i - begin;
+      const auto row = (y + k / w) * width;
+      const auto col = x + k % w;
+      const auto n = std::min(w - k % w, last - i);
+
+      const float *__restrict d = depth + row + col;
+      const float *__restrict rx = ray_x.data() + row + col;
+      const float *__restrict ry = ray_y.data() + row + col;
+      float *__restrict px = out.x.data() + i;
+      float *__restrict py = out.y.data() + i;
+      float *__restrict pz = out.z.data() + i;
+      uint32_t *__restrict pi = out.index.data() + i;
+
+      // Branch free so the compiler can keep it in vector registers,
+      // NaN depth fails both comparisons and ends up as a NaN point
+      for (size_t c = 0; c < n; ++c)
+      {
+        float z = d[c] / 1000.0f;
+        bool valid = z > 0.001f && z < max_z;
+
+        z = valid ? z : NAN;
+        px[c] = rx[c] * z;
+        py[c] = ry[c] * z;
+        pz[c] = z;
+        pi[c] = row + col + c;
+      }
+
+      i += n;
+    }
+
+    auto *mask = out.valid.data();
+    for (size_t i = first; i < last; ++i)
+    {
+      const float z = out.z[i];
+      mask[i / PointCloud::mask_bits] |= PointCloud::Mask(z == z)
+                                         << (i % PointCloud::mask_bits);
+    }
+  }
+
+  bool
+  DepthRays::matches(const libfreenect2::Registration &reg,
+                     float tolerance) const
+  {
+    libfreenect2::Frame frame(width, height, sizeof(float));
+    auto *data = reinterpret_cast<float *>(frame.data);
+
+    // Spread depth over the whole working range of the sensor
+    for (size_t i = 0; i < width * height; ++i)
+      data[i] = 500.0f + (i % 4000);
+
+    PointCloud points;
+    project(data, 0, 0, width, height, points);
+
+    for (size_t r = 0; r < height; ++r)
+    {
+      for (size_t c = 0; c < width; ++c)
+      {
+        Point3f p;
+        const auto q = points[r * width + c];
+
+        reg.getPointXYZ(&frame, r, c, p.x, p.y, p.z);
+
+        if (std::fabs(p.x - q.x) > tolerance ||
+            std::fabs(p.y - q.y) > tolerance ||
+            std::fabs(p.z - q.z) > tolerance)
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+} // namespace farsight
@@ -1,9 +1,17 @@
 #include "3d.h"
+#include "cluster_stats.h"
+#include "voxel_grid.h"
+#include "worker_pool.h"
 #include <vector>
 #include <algorithm>
 #include <cmath>
 #include <fmt/format.h>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <random>
+#include <unordered_map>
+#include <utility>
 
 #define likely(x) __builtin_expect((x), 1)
 #define unlikely(x) __builtin_expect((x), 0)
@@ -16,72 +24,115 @@ T random(T min, T max) {
 
 class DisjointSet
 {
- using CategoryCounter = std::vector<int>;
+ using CategoryCounter = std::pmr::vector<int>;
 
  double distanceThreshold = 0.02; // in meters
  int objectValidSize = 100; // in meters
  constexpr static size_t nan_label = 0;
  constexpr static size_t point_unset= 424*512;
- constexpr static size_t label_reset = 1;
- constexpr static size_t max_catgory_number = 255;
+ constexpr static uint32_t no_point = UINT32_MAX;
+ constexpr static double min_cell_size = 0.001; // in meters
+ constexpr static size_t tile_rows = 32;
  
 public:
+  enum class SearchMode
+  {
+    EXHAUSTIVE,  // compare with every point added so far
+    SPATIAL_HASH // compare only with points in 27 neighbouring cells
+  };
+
+  // Node of the disjoint-set forest, one per created category. Label
+  // is the index of the root, valid only after flatten(). Stats of a
+  // root summarize its whole cluster.
   struct CategoryDescriptor
   {
-    static inline size_t next_label = label_reset;
-    int size = 0;
-    int label = label_reset;
+    farsight::ClusterStats stats;
+    size_t label = nan_label;
+    size_t parent = nan_label;
+    uint8_t rank = 0;
     farsight::ColorType color;
-    CategoryDescriptor()
-    {
-      label = next_label++;
-      color.packed = random(0, (1<<24)-1);
-    }
 
-    CategoryDescriptor(int l)
+    CategoryDescriptor(size_t l)
+      : label(l)
+      , parent(l)
     {
-      label = l;
-    }
-    CategoryDescriptor(const CategoryDescriptor &c)
-    {
-        label = c.label;
-        size = c.size;
+      color.packed = random(0, (1<<24)-1);
     }
-    CategoryDescriptor(CategoryDescriptor &&) = delete;
   };
 
   struct DisjointPoint
   {
     farsight::Point3f p;
     size_t category = point_unset;
+    uint32_t index = 0;
+    uint32_t next_in_cell = no_point;
 
     DisjointPoint() =delete;
 
-    DisjointPoint(farsight::Point3f &p1)
+    DisjointPoint(farsight::Point3f &p1, uint32_t idx)
       : p(p1)
       , category(point_unset)
+      , index(idx)
     {}
-    DisjointPoint(farsight::Point3f &p1, size_t cat)
+    DisjointPoint(farsight::Point3f &p1, size_t cat, uint32_t idx)
       : p(p1)
       , category(cat)
+      , index(idx)
     {}
   };
 
-  void fixCategory(CategoryDescriptor &from, CategoryDescriptor &to)
+  // Root of the category with path halving
+  size_t
+  findRoot(size_t c)
   {
-    auto f_label = from.label;
-    auto t_label = to.label;
-    auto color= to.color;
-    auto cat_size = categories.size();
-    for(auto &cat : categories)
+    while (storage->categories[c].parent != c)
     {
-        if(cat.label == f_label)
-        {
-            cat.label = t_label;
-            cat.color= color;
-            assert(cat.label < cat_size);
-        }
+      auto &parent = storage->categories[c].parent;
+      parent = storage->categories[parent].parent;
+      c = parent;
     }
+    return c;
+  }
+
+  size_t
+  findRoot(size_t c) const
+  {
+    while (storage->categories[c].parent != c)
+      c = storage->categories[c].parent;
+    return c;
+  }
+
+  // Union by rank, the higher tree keeps its root
+  void
+  unite(size_t a, size_t b)
+  {
+    a = findRoot(a);
+    b = findRoot(b);
+    if (a == b)
+      return;
+
+    if (storage->categories[a].rank < storage->categories[b].rank)
+      std::swap(a, b);
+
+    storage->categories[b].parent = a;
+    storage->categories[a].stats.merge(storage->categories[b].stats);
+    if (storage->categories[a].rank == storage->categories[b].rank)
+      storage->categories[a].rank++;
+
+    flattened = false;
+  }
+
+  // Resolves label of every category to its root
+  void
+  flatten()
+  {
+    if (flattened)
+      return;
+
+    for (size_t i = 0; i < storage->categories.size(); i++)
+      storage->categories[i].label = findRoot(i);
+
+    flattened = true;
   }
 
   double
@@ -98,6 +149,8 @@ public:
   {
     fmt::print("Current treshold: {}\n", tr);
     distanceThreshold = tr;
+    // incremental labels were computed with the old threshold
+    organizedColumns = 0;
   }
 
   void
@@ -116,91 +169,470 @@ public:
     return val;
   }
 
+  void
+  setSearchMode(SearchMode mode)
+  {
+    searchMode = mode;
+  }
+
   DisjointPoint
-  classify(farsight::Point3f &p)
+  classify(farsight::Point3f &p, uint32_t index)
   {
-    DisjointPoint p_tmp(p);
-    // chech every point in set
-    // if point is near enough to some point assign new category
-    for (auto &dp : points)
-    {
-      if (std::isnan(dp.p.x) || calcMetric(dp.p, p) > distanceThreshold)
+    DisjointPoint p_tmp(p, index);
+
+    auto visit = [&](const DisjointPoint &dp) {
+      if (calcMetric(dp.p, p) > distanceThreshold)
       {
-        continue;
+        return;
       }
 
       if (p_tmp.category == point_unset)
       {
         p_tmp.category = dp.category;
-        continue;
+        return;
       }
 
-      if(categories[p_tmp.category].label != categories[dp.category].label)
-      {
-        fixCategory(categories[dp.category], categories[p_tmp.category]);
-      }
+      unite(p_tmp.category, dp.category);
+    };
+
+    // if point is near enough to some point assign new category
+    if (searchMode == SearchMode::EXHAUSTIVE)
+    {
+      for (auto &dp : storage->points)
+        visit(dp);
+
+      return p_tmp;
     }
+
+    // Cells are as big as the threshold, so every point within the
+    // distance lies in one of the 27 cells around the point
+    auto cx = farsight::voxel_coord(p.x, cellInvSize);
+    auto cy = farsight::voxel_coord(p.y, cellInvSize);
+    auto cz = farsight::voxel_coord(p.z, cellInvSize);
+
+    for (int64_t dz = -1; dz <= 1; ++dz)
+      for (int64_t dy = -1; dy <= 1; ++dy)
+        for (int64_t dx = -1; dx <= 1; ++dx)
+        {
+          auto cell = storage->cells.find(farsight::voxel_key(cx + dx, cy + dy, cz + dz));
+          if (cell == storage->cells.end())
+            continue;
+
+          for (auto i = cell->second; i != no_point; i = storage->points[i].next_in_cell)
+            visit(storage->points[i]);
+        }
+
     // if is already attached and can be merged to another group
     // attach group pointer to such group and increment its size
     return p_tmp;
   }
 
   void
-  addPoint(farsight::Point3f p)
+  insert(DisjointPoint dp)
   {
-    if(unlikely(categories.size() == 0))
+    auto key = farsight::voxel_key(dp.p.x, dp.p.y, dp.p.z, cellInvSize);
+    auto [cell, inserted] = storage->cells.try_emplace(key, no_point);
+
+    dp.next_in_cell = cell->second;
+    cell->second = storage->points.size();
+    storage->points.push_back(dp);
+  }
+
+  // Only valid points take part in clustering
+  void
+  addPoints(const farsight::PointCloud &cloud)
+  {
+    width = cloud.width;
+    storage->points.reserve(storage->points.size() + cloud.count_valid());
+    storage->cells.reserve(storage->cells.size() + cloud.count_valid());
+
+    cloud.for_each_valid([&](size_t i) {
+      addPoint({ cloud.x[i], cloud.y[i], cloud.z[i] }, cloud.index[i]);
+    });
+  }
+
+  // Clustering of a cloud organized as an image of given columns, like
+  // a projected bbox before compaction. Raster scan unites every valid
+  // pixel with its already visited 4 or 8 connected neighbours closer
+  // than the threshold, labels are resolved by flatten(). Linear in
+  // pixel count, no global search.
+  // With a pool, bands of tile_rows rows are clustered by its threads
+  // and united along band borders afterwards. Band height does not depend
+  // on the thread count, so the result is the same as without a pool.
+  void
+  addOrganizedPoints(const farsight::PointCloud &cloud,
+                     size_t columns,
+                     bool eightConnected = true,
+                     farsight::WorkerPool *pool = nullptr)
+  {
+    assert(columns > 0 && cloud.size() % columns == 0);
+
+    width = cloud.width;
+    auto rows = cloud.size() / columns;
+    auto tiles = (rows + tile_rows - 1) / tile_rows;
+
+    reserveOrganized(cloud.count_valid(), columns);
+
+    if (!pool || tiles < 2)
+    {
+      addOrganizedRows(cloud, columns, 0, rows, eightConnected);
+      return;
+    }
+
+    // Every allocation of the tiles happens here, workers only fill
+    // reserved storage, so the resource does not need to be thread safe
+    auto *resource = storage->points.get_allocator().resource();
+    std::pmr::vector<DisjointSet> local(resource);
+    local.reserve(tiles);
+
+    for (size_t t = 0; t < tiles; t++)
+    {
+      auto first = t * tile_rows, last = std::min(rows, first + tile_rows);
+
+      auto &tile = local.emplace_back();
+      tile.reset(resource);
+      tile.distanceThreshold = distanceThreshold;
+      tile.reserveOrganized(
+        cloud.count_valid(first * columns, last * columns), columns);
+    }
+
+    pool->parallel_for(0, tiles, 1, [&](size_t begin, size_t end) {
+      for (auto t = begin; t < end; t++)
+      {
+        auto first = t * tile_rows, last = std::min(rows, first + tile_rows);
+        local[t].addOrganizedRows(
+          cloud, columns, first, last, eightConnected);
+      }
+    });
+
+    // Tiles are appended in raster order, their nan category is dropped
+    for (size_t t = 0; t < tiles; t++)
+    {
+      auto pointBase = storage->points.size();
+      auto categoryBase = storage->categories.size() - 1;
+
+      for (size_t i = 1; i < local[t].storage->categories.size(); i++)
+      {
+        auto &c = storage->categories.emplace_back(local[t].storage->categories[i]);
+        c.parent += categoryBase;
+        c.label += categoryBase;
+      }
+
+      for (auto dp : local[t].storage->points)
+      {
+        dp.category += categoryBase;
+        storage->points.push_back(dp);
+      }
+
+      if (t > 0)
+        stitchRows(cloud, columns, t * tile_rows, pointBase, eightConnected);
+    }
+    flattened = false;
+  }
+
+  // Storage for n more organized points in rows of given columns
+  void
+  reserveOrganized(size_t n, size_t columns)
+  {
+    if(unlikely(storage->categories.size() == 0))
     {
       // add default nan label for nan points
-      categories.emplace_back(nan_label);
+      storage->categories.emplace_back(nan_label);
     }
 
-    if(likely(std::isnan(p.x)))
+    storage->points.reserve(storage->points.size() + n);
+    storage->categories.reserve(storage->categories.size() + n);
+    storage->rowLinks.resize(2 * columns);
+  }
+
+  // Raster scan of rows [firstRow, lastRow), storage has to be reserved
+  void
+  addOrganizedRows(const farsight::PointCloud &cloud,
+                   size_t columns,
+                   size_t firstRow,
+                   size_t lastRow,
+                   bool eightConnected)
+  {
+    assert(storage->rowLinks.size() >= 2 * columns);
+
+    // point of every pixel in previous and current row
+    auto *prev = storage->rowLinks.data(), *cur = storage->rowLinks.data() + columns;
+    std::fill(prev, prev + columns, no_point);
+
+    for (auto r = firstRow; r < lastRow; r++)
     {
-      categories[0].size += 1;
-      points.emplace_back(p, 0);
-      return;
+      auto begin = r * columns;
+
+      for (size_t c = 0; c < columns; c++)
+      {
+        cur[c] = no_point;
+        if (!cloud.is_valid(begin + c))
+          continue;
+
+        farsight::Point3f p = { cloud.x[begin + c],
+                                cloud.y[begin + c],
+                                cloud.z[begin + c] };
+        DisjointPoint dp(p, cloud.index[begin + c]);
+
+        auto link = [&](uint32_t n) {
+          if (n == no_point || calcMetric(storage->points[n].p, p) > distanceThreshold)
+            return;
+
+          if (dp.category == point_unset)
+            dp.category = storage->points[n].category;
+          else
+            unite(dp.category, storage->points[n].category);
+        };
+
+        if (c > 0)
+          link(cur[c - 1]);
+        link(prev[c]);
+        if (eightConnected)
+        {
+          if (c > 0)
+            link(prev[c - 1]);
+          if (c + 1 < columns)
+            link(prev[c + 1]);
+        }
+
+        if (dp.category == point_unset)
+        {
+          dp.category = storage->categories.size();
+          storage->categories.emplace_back(dp.category);
+          flattened = false;
+        }
+        storage->categories[findRoot(dp.category)].stats.add(p.x, p.y, p.z);
+
+        cur[c] = storage->points.size();
+        storage->points.push_back(dp);
+      }
+      std::swap(prev, cur);
+    }
+  }
+
+  // Unites points of row with the row above it, points of the row start
+  // at rowPoint and are directly preceded by points of the row above
+  void
+  stitchRows(const farsight::PointCloud &cloud,
+             size_t columns,
+             size_t row,
+             size_t rowPoint,
+             bool eightConnected)
+  {
+    auto begin = row * columns;
+    auto *prev = storage->rowLinks.data(), *cur = storage->rowLinks.data() + columns;
+    auto abovePoint = rowPoint - cloud.count_valid(begin - columns, begin);
+
+    for (size_t c = 0; c < columns; c++)
+    {
+      prev[c] = cloud.is_valid(begin - columns + c) ? abovePoint++ : no_point;
+      cur[c] = cloud.is_valid(begin + c) ? rowPoint++ : no_point;
+    }
+
+    for (size_t c = 0; c < columns; c++)
+    {
+      if (cur[c] == no_point)
+        continue;
+
+      auto &dp = storage->points[cur[c]];
+      auto link = [&](uint32_t n) {
+        if (n != no_point &&
+            calcMetric(storage->points[n].p, dp.p) <= distanceThreshold)
+          unite(dp.category, storage->points[n].category);
+      };
+
+      link(prev[c]);
+      if (eightConnected)
+      {
+        if (c > 0)
+          link(prev[c - 1]);
+        if (c + 1 < columns)
+          link(prev[c + 1]);
+      }
     }
+  }
+
+  // Incremental organized clustering of a cloud holding the same pixels
+  // as the previous call, e.g. the same bbox of the next frame. Pixels
+  // that moved more than tolerance, appeared or vanished dissolve the
+  // clusters they belonged to and only pixels of those clusters are
+  // clustered again. Other clusters keep labels, positions and stats, so
+  // the result is the one of addOrganizedPoints() up to tolerance.
+  // Any other cloud is clustered whole. Returns the reclustered pixels.
+  size_t
+  updateOrganizedPoints(const farsight::PointCloud &cloud,
+                        size_t columns,
+                        double tolerance,
+                        bool eightConnected = true)
+  {
+    assert(columns > 0 && cloud.size() % columns == 0);
+
+    auto n = cloud.size();
+    bool same = organizedColumns == columns && storage->points.size() == n &&
+                n > 0 && storage->points.front().index == cloud.index.front();
+
+    // nodes of dissolved clusters pile up, start over once they dominate
+    if (!same || storage->categories.size() > 2 * n + 1)
+    {
+      reset(storage->points.get_allocator().resource());
+      organizedColumns = columns;
+      width = cloud.width;
+      storage->categories.emplace_back(nan_label);
+      storage->points.reserve(n);
+
+      for (size_t i = 0; i < n; i++)
+      {
+        farsight::Point3f p = { cloud.x[i], cloud.y[i], cloud.z[i] };
+        storage->points.emplace_back(p, cloud.index[i]);
+      }
+      storage->dirtyPixels.assign(n, 1);
+    }
+    else
+    {
+      flatten();
+      storage->dirtyPixels.assign(n, 0);
+      storage->dissolved.assign(storage->categories.size(), 0);
+
+      for (size_t i = 0; i < n; i++)
+      {
+        auto &dp = storage->points[i];
+        bool valid = cloud.is_valid(i), was = dp.category != nan_label;
+
+        farsight::Point3f p = { cloud.x[i], cloud.y[i], cloud.z[i] };
+        if (valid == was && (!valid || calcMetric(dp.p, p) <= tolerance))
+          continue;
+
+        storage->dirtyPixels[i] = 1;
+        if (was)
+          storage->dissolved[storage->categories[dp.category].label] = 1;
+      }
+
+      for (size_t i = 0; i < n; i++)
+      {
+        auto category = storage->points[i].category;
+        if (category != nan_label && storage->dissolved[storage->categories[category].label])
+          storage->dirtyPixels[i] = 1;
+      }
+
+      for (size_t c = 1; c < storage->categories.size(); c++)
+      {
+        if (storage->dissolved[c])
+          storage->categories[c].stats = {};
+      }
+    }
+
+    // dirty pixels wait for a category, invalid ones never get one
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      if (!storage->dirtyPixels[i])
+        continue;
+
+      auto &dp = storage->points[i];
+      dp.p = { cloud.x[i], cloud.y[i], cloud.z[i] };
+      dp.category = cloud.is_valid(i) ? point_unset : nan_label;
+      count++;
+    }
+
+    // neighbours waiting for a category link to this pixel later
+    const int rows = n / columns;
+    for (int r = 0; r < rows; r++)
+    {
+      for (int c = 0; c < int(columns); c++)
+      {
+        auto &dp = storage->points[r * columns + c];
+        if (dp.category != point_unset)
+          continue;
+
+        size_t category = point_unset;
+        for (int dr = -1; dr <= 1; dr++)
+        {
+          for (int dc = -1; dc <= 1; dc++)
+          {
+            if ((dr == 0 && dc == 0) || (!eightConnected && dr && dc) ||
+                r + dr < 0 || r + dr >= rows || c + dc < 0 ||
+                c + dc >= int(columns))
+              continue;
+
+            auto &nb = storage->points[(r + dr) * columns + c + dc];
+            if (nb.category == nan_label || nb.category == point_unset ||
+                calcMetric(nb.p, dp.p) > distanceThreshold)
+              continue;
+
+            if (category == point_unset)
+              category = nb.category;
+            else
+              unite(category, nb.category);
+          }
+        }
+
+        if (category == point_unset)
+        {
+          category = storage->categories.size();
+          storage->categories.emplace_back(category);
+        }
+        dp.category = category;
+        storage->categories[findRoot(category)].stats.add(dp.p.x, dp.p.y, dp.p.z);
+      }
+    }
+    flattened = false;
+
+    return count;
+  }
+
+  void
+  addPoint(farsight::Point3f p, uint32_t index)
+  {
+    if(unlikely(storage->categories.size() == 0))
+    {
+      // add default nan label for nan points
+      storage->categories.emplace_back(nan_label);
+    }
+
     // if set is empty, create new classification group
-    if (unlikely(categories.size() == 1))
+    if (unlikely(storage->categories.size() == 1))
     {
-      categories.emplace_back();
-      categories[1].size = 1;
-      points.emplace_back(p, 1);
+      // threshold may change between frames only
+      cellInvSize = 1.0f / std::max(distanceThreshold, min_cell_size);
+      storage->categories.emplace_back(1);
+      storage->categories[1].stats.add(p.x, p.y, p.z);
+      insert(DisjointPoint(p, 1, index));
+      flattened = false;
       return;
     }
 
-    auto classified_p = classify(p);
+    auto classified_p = classify(p, index);
 
     if(classified_p.category == point_unset)
     {
         // create new group
-        categories.emplace_back();
-        auto &cat = categories.back();
-        cat.size = 1;
-        classified_p.category = categories.size()-1;
-    }else
-    {
-        categories[classified_p.category].size += 1;
+        classified_p.category = storage->categories.size();
+        storage->categories.emplace_back(classified_p.category);
+        flattened = false;
     }
-    points.push_back(classified_p);
+    storage->categories[findRoot(classified_p.category)].stats.add(p.x, p.y, p.z);
+    insert(classified_p);
   }
 
   CategoryCounter
   countCategories()
   {
-    if(unlikely(categories.size() == 0))
+    if(unlikely(storage->categories.size() == 0))
     {
         fmt::print(stderr, "No unions found");
         return {};
     }
-    int cat_size = categories.size();
-    CategoryCounter categories_lookup = CategoryCounter(cat_size, 0);
-    // sum up all categories
+    flatten();
+    int cat_size = storage->categories.size();
+    CategoryCounter categories_lookup =
+      CategoryCounter(cat_size, 0, storage->categories.get_allocator());
+    // roots hold sizes of whole clusters
     for(int i =1 ; i < cat_size; i++)
     {
-        assert(categories[i].label < cat_size);
+        assert(storage->categories[i].label < cat_size);
 
-        categories_lookup[categories[i].label] += categories[i].size;
+        if (storage->categories[i].label == i)
+          categories_lookup[i] = storage->categories[i].stats.count;
     }
 
     return categories_lookup;
@@ -209,7 +641,7 @@ public:
   CategoryDescriptor
   findBiggestCategory(CategoryCounter &cc)
   {
-    int cat_size = categories.size();
+    int cat_size = storage->categories.size();
     // find biggest category
     size_t max = 0, idx = 0;
     for(int i =1 ; i < cat_size; i++)
@@ -221,79 +653,176 @@ public:
         }
     }
 
-    for(int i =0 ; i < categories.size(); i++)
+    for(int i =0 ; i < storage->categories.size(); i++)
     {
         fmt::print("Category with label: {}, size: {}\n", i,cc[i]);
     }
 
-    return categories[idx];
+    return storage->categories[idx];
+  }
+
+  // Summary of the cluster with given label
+  const farsight::ClusterStats &
+  getClusterStats(size_t label)
+  {
+    flatten();
+    return storage->categories[storage->categories[label].label].stats;
+  }
+
+  // Calls f(label, stats) for every cluster
+  template<typename F>
+  void
+  forEachCluster(F &&f)
+  {
+    flatten();
+    for (size_t i = 1; i < storage->categories.size(); i++)
+    {
+      // roots of dissolved clusters are left empty
+      if (storage->categories[i].label == i && !storage->categories[i].stats.empty())
+        f(i, std::as_const(storage->categories[i].stats));
+    }
+  }
+
+  // Summary of all clusters bigger than objectValidSize together
+  farsight::ClusterStats
+  getValidStats()
+  {
+    farsight::ClusterStats valid;
+    forEachCluster([&](size_t, const farsight::ClusterStats &stats) {
+      if (stats.count > size_t(objectValidSize))
+        valid.merge(stats);
+    });
+    return valid;
   }
 
-  farsight::PointArray
-  getFilteredPoints(CategoryDescriptor &c1)
+  farsight::PointCloud
+  getFilteredPoints(CategoryDescriptor &c1,
+                     std::pmr::memory_resource *resource =
+                       std::pmr::get_default_resource())
   {
+    flatten();
     auto label = c1.label;
-    farsight::PointArray map;
+    farsight::PointCloud map(resource);
     farsight::ColorType color;
-    farsight::Point3f nan_p = { NAN, NAN, NAN};
-    for (auto &dp : points)
+    color.packed = 0xdd88ff;
+    map.width = width;
+    map.reserve(storage->points.size());
+    for (auto &dp : storage->points)
     {
-      auto p_label = categories[dp.category].label;
-      if (label == p_label)
-      {
-        color.packed = 0xdd88ff;
-        map.emplace_back(dp.p, color);
-      }else{
-        color.packed = 0x0;
-        map.emplace_back(nan_p, color);
-      }
+      if (storage->categories[dp.category].label == label)
+        map.push_back(dp.p, color, dp.index);
     }
     return map;
   }
 
-  farsight::PointArray
-  getPointsByDelimiter(CategoryCounter &cc)
+  farsight::PointCloud
+  getPointsByDelimiter(CategoryCounter &cc,
+                     std::pmr::memory_resource *resource =
+                       std::pmr::get_default_resource())
   {
-    farsight::PointArray map;
+    flatten();
+    farsight::PointCloud map(resource);
     farsight::ColorType color;
-    farsight::Point3f nan_p = { NAN, NAN, NAN};
-    for (auto &dp : points)
+    color.packed = 0xdd88ff;
+    map.width = width;
+    map.reserve(storage->points.size());
+    for (auto &dp : storage->points)
     {
-      auto label= categories[dp.category].label;
+      auto label= storage->categories[dp.category].label;
       if (cc[label] > objectValidSize)
-      {
-        color.packed = 0xdd88ff;
-        map.emplace_back(dp.p, color);
-      }else{
-        color.packed = 0x0;
-        map.emplace_back(nan_p, color);
-      }
+        map.push_back(dp.p, color, dp.index);
     }
     return map;
   }
 
-  farsight::PointArray
-  getFilteredPointsColors(CategoryDescriptor &c1)
+  // Points of clusters bigger than objectValidSize as a compact cloud,
+  // sizes come from cluster stats so no counting pass is needed
+  farsight::PointCloud
+  getValidPoints(std::pmr::memory_resource *resource =
+                   std::pmr::get_default_resource())
   {
-    auto label = c1.label;
-    farsight::PointArray map;
-    int counter = 0;
-    for (auto &dp : points)
+    flatten();
+    farsight::PointCloud map(resource);
+    farsight::ColorType color;
+    color.packed = 0xdd88ff;
+    map.width = width;
+    map.reserve(storage->points.size());
+    for (auto &dp : storage->points)
     {
-      auto color = categories[dp.category].color;
-      map.emplace_back(dp.p, color);
+      auto label = storage->categories[dp.category].label;
+      if (storage->categories[label].stats.count > size_t(objectValidSize))
+        map.push_back(dp.p, color, dp.index);
     }
     return map;
   }
 
-  void reset()
+  farsight::PointCloud
+  getFilteredPointsColors(CategoryDescriptor &c1,
+                     std::pmr::memory_resource *resource =
+                       std::pmr::get_default_resource())
   {
-    points.clear();
-    categories.clear();
-    CategoryDescriptor::next_label = label_reset;
+    flatten();
+    farsight::PointCloud map(resource);
+    map.width = width;
+    map.reserve(storage->points.size());
+    for (auto &dp : storage->points)
+    {
+      auto color = storage->categories[storage->categories[dp.category].label].color;
+      map.push_back(dp.p, color, dp.index);
+    }
+    return map;
+  }
+
+  size_t
+  size() const
+  {
+    return storage->points.size();
+  }
+
+  size_t
+  pointLabel(size_t i) const
+  {
+    return findRoot(storage->points[i].category);
+  }
+
+  // Storage of next classification comes from resource. The old storage
+  // is given back here, so a resource has to outlive the set or its next
+  // reset, whichever comes first.
+  void reset(std::pmr::memory_resource *resource =
+               std::pmr::get_default_resource())
+  {
+    // pmr containers never change resource on assignment, rebuild them
+    storage.reset();
+    storage.emplace(resource);
+    organizedColumns = 0;
+    flattened = true;
   }
 
 private:
-  std::vector<DisjointPoint> points;
-  std::vector<CategoryDescriptor> categories;
+  // Every container allocating from the resource of the set
+  struct Storage
+  {
+    std::pmr::vector<DisjointPoint> points;
+    std::pmr::vector<CategoryDescriptor> categories;
+    std::pmr::unordered_map<uint64_t, uint32_t> cells;
+    std::pmr::vector<uint32_t> rowLinks;
+    std::pmr::vector<uint8_t> dirtyPixels, dissolved;
+
+    explicit Storage(std::pmr::memory_resource *resource)
+      : points(resource)
+      , categories(resource)
+      , cells(resource)
+      , rowLinks(resource)
+      , dirtyPixels(resource)
+      , dissolved(resource)
+    {}
+  };
+
+  size_t width = 1;
+  std::optional<Storage> storage{ std::in_place,
+                                  std::pmr::get_default_resource() };
+  size_t organizedColumns = 0;
+  SearchMode searchMode = SearchMode::SPATIAL_HASH;
+  float cellInvSize = 1.0f;
+  bool flattened = true;
 };
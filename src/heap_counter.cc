@@ -0,0 +1,111 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "heap_counter.h"
+
+// Replacements of the global allocation functions. The array and nothrow
+// forms of the standard library forward to these, so every form counts.
+// Every allocation of the process pays for the shared counters, so they
+// are built only with COUNT_HEAP_ALLOCATIONS.
+
+#ifdef FARSIGHT_COUNT_HEAP
+
+namespace {
+
+  std::atomic<size_t> allocations = 0, bytes = 0;
+  thread_local size_t thread_allocations = 0, thread_bytes = 0;
+
+  void
+  count(size_t size)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    thread_allocations++;
+    thread_bytes += size;
+  }
+
+  void *
+  allocate(size_t size, size_t alignment)
+  {
+    count(size);
+
+    if (size == 0)
+      size = 1;
+
+    void *p;
+    if (alignment <= alignof(std::max_align_t))
+      p = std::malloc(size);
+    else
+      p = std::aligned_alloc(alignment,
+                             (size + alignment - 1) / alignment * alignment);
+
+    if (!p)
+      throw std::bad_alloc();
+    return p;
+  }
+
+} // namespace
+
+void *
+operator new(size_t size)
+{
+  return allocate(size, alignof(std::max_align_t));
+}
+
+void *
+operator new(size_t size, std::align_val_t alignment)
+{
+  return allocate(size, size_t(alignment));
+}
+
+void
+operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void *p, size_t) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void *p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+#endif // FARSIGHT_COUNT_HEAP
+
+namespace farsight {
+
+  HeapCount
+  heap_count()
+  {
+#ifdef FARSIGHT_COUNT_HEAP
+    return { allocations.load(std::memory_order_relaxed),
+             bytes.load(std::memory_order_relaxed) };
+#else
+    return {};
+#endif
+  }
+
+  HeapCount
+  thread_heap_count()
+  {
+#ifdef FARSIGHT_COUNT_HEAP
+    return { thread_allocations, thread_bytes };
+#else
+    return {};
+#endif
+  }
+
+} // namespace farsight
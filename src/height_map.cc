@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+
+#include "height_map.h"
+
+namespace farsight {
+
+  HeightMap::HeightMap(const OrientedBox &box, float floor_y, float cell_size)
+  {
+    reset(box, floor_y, cell_size);
+  }
+
+  void
+  HeightMap::reset(const OrientedBox &box, float floor_y, float cell_size)
+  {
+    this->floor_y = floor_y;
+
+    glm::vec3 center{ box.center.x, box.center.y, box.center.z };
+
+    origin = center - box.axes[0] * (box.extents.x / 2) -
+             box.axes[1] * (box.extents.y / 2);
+
+    // cells shrink from cell_size until a whole number of them covers
+    // the box, so its edges fall on cell edges. A footprint that is no
+    // rectangle still fills cells on its outline only partly.
+    cols = std::max<size_t>(std::ceil(box.extents.x / cell_size - 1e-3f), 1);
+    rows = std::max<size_t>(std::ceil(box.extents.y / cell_size - 1e-3f), 1);
+    cell_area = double(box.extents.x) / cols * box.extents.y / rows;
+
+    u = box.extents.x > 0 ? box.axes[0] * (cols / box.extents.x)
+                          : glm::vec3{ 0, 0, 0 };
+    v = box.extents.y > 0 ? box.axes[1] * (rows / box.extents.y)
+                          : glm::vec3{ 0, 0, 0 };
+
+    // grid storage is kept between measurements
+    cells.assign(cols * rows, 0.0f);
+  }
+
+  void
+  HeightMap::add(const PointCloud &cloud)
+  {
+    constexpr size_t block = PointCloud::mask_bits;
+    const float max_col = cols - 1, max_row = rows - 1;
+    const int32_t stride = cols;
+    const float ox = origin.x, oy = origin.y, oz = origin.z;
+    const float ux = u.x, uy = u.y, uz = u.z;
+    const float vx = v.x, vy = v.y, vz = v.z;
+    const float base = floor_y;
+
+    int32_t cell[block];
+    float height[block];
+
+    // cells of a whole mask word are computed without branches, the
+    // scalar pass keeping maxima then visits only the valid ones
+    for (size_t b = 0; b < cloud.size(); b += block)
+    {
+      auto mask = cloud.valid[b / block];
+      if (!mask)
+        continue;
+
+      const size_t n = std::min(block, cloud.size() - b);
+      const float *x = cloud.x.data() + b;
+      const float *y = cloud.y.data() + b;
+      const float *z = cloud.z.data() + b;
+
+      for (size_t i = 0; i < n; ++i)
+      {
+        float dx = x[i] - ox, dy = y[i] - oy, dz = z[i] - oz;
+        float s = dx * ux + dy * uy + dz * uz;
+        float t = dx * vx + dy * vy + dz * vz;
+
+        // comparisons in this order also send NaN to 0
+        s = s > 0 ? s : 0;
+        s = s < max_col ? s : max_col;
+        t = t > 0 ? t : 0;
+        t = t < max_row ? t : max_row;
+
+        cell[i] = int32_t(t) * stride + int32_t(s);
+        height[i] = y[i] - base;
+      }
+
+      for (; mask; mask &= mask - 1)
+      {
+        auto i = __builtin_ctzll(mask);
+        cells[cell[i]] = std::max(cells[cell[i]], height[i]);
+      }
+    }
+  }
+
+  HeightMapStats
+  HeightMap::result() const
+  {
+    HeightMapStats stats;
+    double sum = 0;
+    size_t occupied = 0;
+    float top = 0;
+
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+      float h = cells[i];
+      sum += h;
+      occupied += h > 0;
+      top = std::max(top, h);
+    }
+
+    stats.volume = sum * cell_area;
+    stats.footprint = occupied * cell_area;
+    stats.top = top;
+    stats.occupied = occupied;
+
+    return stats;
+  }
+
+} // namespace farsight
@@ -1,9 +1,12 @@
 #include "image_proc.hpp"
 #include "3d.h"
+#include "cloud_dump.h"
 #include <fmt/format.h>
+#include <algorithm>
 #include <array>
 
-detector::detector()
+detector::detector(size_t cameras)
+  : config(cameras)
 {
   cv::SimpleBlobDetector::Params params;
   params.filterByArea = true;
@@ -12,7 +15,7 @@ detector::detector()
 
   det = cv::SimpleBlobDetector::create(params);
   configScreen = cv::Mat::zeros(
-    cv::Size(depth_width * 2 + 10, depth_height * 2 + 10), CV_8UC1);
+    cv::Size(depth_width * 2 + 10, depth_height * cameras + 10), CV_8UC1);
 }
 
 bbox detector::detect(int kinectID, byte *frame_object, size_t size, cv::Mat &image_depth)
@@ -63,133 +66,156 @@ detector::setConfig(int kinectID,
                     objectType t,
                     const cv::Mat &img,
                     const bbox &a,
-                    const farsight::PointArray &pointCloud)
+                    const farsight::PointCloud &pointCloud,
+                    const farsight::ClusterStats &stats)
 {
   auto &c =config[kinectID].objects[to_underlying(t)];
   c.area = a;
   img.copyTo(c.imgDepth);
-  c.pointCloud = pointCloud;
+  // a spare still queued for writing is left to the writer, a new one
+  // is made only when dumps pile up
+  if (c.spareCloud.use_count() > 1)
+    c.spareCloud = std::make_shared<farsight::PointCloud>();
+  std::swap(c.pointCloud, c.spareCloud);
+  *c.pointCloud = pointCloud;
+  c.stats = stats;
   c.configured = true;
 }
 
-cv::RotatedRect
-detector::calcBiggestComponent()
+farsight::OrientedBox
+detector::measureBox()
 {
-  auto &c1 = config[0].objects[to_underlying(objectType::REFERENCE_OBJ)];
-  auto &c2 = config[1].objects[to_underlying(objectType::REFERENCE_OBJ)];
-  
-  if(!c1.configured || !c2.configured)
-    return{};
-  farsight::PointArray map_;
-  std::vector<cv::Point2f> pointsCloudTop;
-  std::vector<cv::Point2f> pointsCloudFront;
-
-  std::copy(
-    c1.pointCloud.begin(), c1.pointCloud.end(), std::back_inserter(map_));
-  FILE *file = fopen("point_cloud_0", "w");
-  for(auto &p :map_)
-  {
-    if(std::isnan(p.x))
-        continue;
-    fmt::print(file, "{} {} {}\n", p.x*1000, p.y*1000, p.z*1000);
-    pointsCloudFront.emplace_back(p.x*1000, p.y*1000);
-    pointsCloudTop.emplace_back(p.x*1000, p.z*1000);
-  }
-  fclose(file);
-  map_.clear();
-  std::copy(
-    c2.pointCloud.begin(), c2.pointCloud.end(), std::back_inserter(map_));
+  constexpr auto ref = to_underlying(objectType::REFERENCE_OBJ);
 
-  FILE *file2 = fopen("point_cloud_1", "w");
-  for(auto &p :map_)
+  // every camera has to see the reference object
+  for (const auto &cam : config)
   {
-    if(std::isnan(p.x))
-        continue;
-    fmt::print(file2, "{} {} {}\n", p.x*1000, p.y*1000, p.z*1000);
-    pointsCloudFront.emplace_back(p.x*1000, p.y*1000);
-    pointsCloudTop.emplace_back(p.x*1000, p.z*1000);
+    if (!cam.objects[ref].configured)
+      return {};
   }
+  // frame of the box comes from the merged stats of all clusters, then
+  // a single pass over the clouds measures it
+  farsight::ClusterStats stats;
+  for (const auto &cam : config)
+    stats.merge(cam.objects[ref].stats);
+
+  if (stats.empty())
+    return {};
+
+  farsight::BoxMeasurer measurer(stats, { 0, 1, 0 });
+  for (const auto &cam : config)
+    measurer.add(*cam.objects[ref].pointCloud);
+
+  return measurer.result();
+}
+
+farsight::HeightMapStats
+detector::measureVolume(const farsight::OrientedBox &box)
+{
+  constexpr auto ref = to_underlying(objectType::REFERENCE_OBJ);
+  const float floor_y = farsight::FLOOR_BASE_Y + farsight::get_floor_level();
+
+  if (box.count == 0)
+    return {};
+
+  heightMap.reset(box, floor_y, heightMapCell);
+  for (const auto &cam : config)
+    heightMap.add(*cam.objects[ref].pointCloud);
+
+  return heightMap.result();
+}
 
-  fclose(file2);
+cv::RotatedRect
+detector::topView(const farsight::OrientedBox &box)
+{
+  float angle = std::atan2(box.axes[0].z, box.axes[0].x) * 180 / M_PI;
+
+  return cv::RotatedRect(
+    cv::Point2f(box.center.x * 1000, box.center.z * 1000),
+    cv::Size2f(box.extents.x * 1000, box.extents.y * 1000),
+    angle);
+}
 
-  map_.clear();
-  std::copy(
-    c1.pointCloud.begin(), c1.pointCloud.end(), std::back_inserter(map_));
-  std::copy(
-    c2.pointCloud.begin(), c2.pointCloud.end(), std::back_inserter(map_));
+double
+detector::heightAboveFloor(const farsight::OrientedBox &box)
+{
+  const double floor_y = farsight::FLOOR_BASE_Y + farsight::get_floor_level();
+  return box.center.y + box.extents.z / 2 - floor_y;
+}
 
-  FILE *file3 = fopen("point_cloud_2", "w");
-  double obj_height= 0;
-  for(auto &p :map_)
+cv::RotatedRect
+detector::calcBiggestComponent()
+{
+  constexpr auto ref = to_underlying(objectType::REFERENCE_OBJ);
+
+  auto box = measureBox();
+  if (box.count == 0)
   {
-    if(std::isnan(p.x))
-        continue;
-    fmt::print(file2, "{} {} {}\n", p.x*1000, p.y*1000, p.z*1000);
-    if(p.y > obj_height)
-        obj_height = p.y;
-    pointsCloudTop.emplace_back(p.x*1000, p.z*1000);
+    fprintf(stderr, "No points found");
+    return {};
   }
-  fclose(file3);
 
-  if(pointsCloudTop.size() == 0 || pointsCloudFront.size() == 0)
+  // Per camera files, then the fused cloud in a file of its own. The
+  // writer gets handles, setConfig never refills a cloud it holds.
+  auto &dumper = farsight::cloud_dumper();
+  if (dumper.is_enabled())
   {
-      fprintf(stderr, "No points found");
-      return{};
+    std::vector<farsight::CloudDumper::CloudPtr> fused;
+    for (size_t k = 0; k < config.size(); k++)
+    {
+      const auto &cloud = config[k].objects[ref].pointCloud;
+      dumper.dump(fmt::format("point_cloud_{}.ply", k), { cloud });
+      fused.push_back(cloud);
+    }
+    dumper.dump(fmt::format("point_cloud_{}.ply", config.size()),
+                std::move(fused));
   }
 
-  auto rectTop = cv::minAreaRect(pointsCloudTop);
-  auto obj_width = rectTop.size.width;
-  auto obj_length = rectTop.size.height;
-
-
-  fmt::print("Found object size : x:{} y:{} z:{}\n", obj_width, (obj_height*1000)+250, obj_length);
+  double obj_height = heightAboveFloor(box);
+  auto rectTop = topView(box);
+  auto volume = measureVolume(box);
+
+  fmt::print("Found object size : x:{} y:{} z:{}\n",
+             rectTop.size.width,
+             obj_height * 1000,
+             rectTop.size.height);
+  fmt::print("Box residuals : x:{} y:{} z:{}\n",
+             box.residuals.x * 1000,
+             box.residuals.z * 1000,
+             box.residuals.y * 1000);
+  fmt::print("Volume : {:.2f} l, footprint : {:.1f} cm2\n",
+             volume.volume * 1000,
+             volume.footprint * 10000);
   return rectTop;
 }
 
 void
 detector::displayCurrectConfig()
 {
-  const auto &cam1 = config[0];
-  const auto &cam2 = config[1];
-
-  const auto &c1_r = cam1.objects[to_underlying(objectType::REFERENCE_OBJ)];
-  const auto &c1_m = cam1.objects[to_underlying(objectType::MEASURED_OBJ)];
-  const auto &c2_r = cam2.objects[to_underlying(objectType::REFERENCE_OBJ)];
-  const auto &c2_m = cam2.objects[to_underlying(objectType::MEASURED_OBJ)];
-  cv::Mat temp;
-
-  matRoi = cv::Rect(0, 0, depth_width, depth_height);
-  resize(cam1.img_base, temp, cv::Size(depth_width, depth_height));
-  temp.copyTo(configScreen(matRoi));
-
-  matRoi = cv::Rect(depth_width, 0, depth_width, depth_height);
-  resize(c1_r.imgDepth, temp, cv::Size(depth_width, depth_height));
-  cv::putText(temp,
-              fmt::format("object {}x{} pixels ", c1_r.area.w, c1_r.area.h),
-              { depth_width / 10, 50 },
-              cv::FONT_HERSHEY_PLAIN,
-              2,
-              cv::Scalar::all(0),
-              3,
-              5);
-  temp.copyTo(configScreen(matRoi));
-
-  matRoi = cv::Rect(0, depth_height, depth_width, depth_height);
-  resize(cam2.img_base, temp, cv::Size(depth_width, depth_height));
-  temp.copyTo(configScreen(matRoi));
-
-  matRoi =
-    cv::Rect(depth_width, depth_height, depth_width, depth_height);
-  resize(c2_r.imgDepth, temp, cv::Size(depth_width, depth_height));
-  cv::putText(temp,
-              fmt::format("object {}x{} pixels ", c2_r.area.w, c2_r.area.h),
-              { depth_width / 10, depth_height / 10 },
-              cv::FONT_HERSHEY_PLAIN,
-              2,
-              cv::Scalar::all(0),
-              3,
-              5);
-  temp.copyTo(configScreen(matRoi));
+  // one row per camera, base image and reference object side by side
+  for (size_t k = 0; k < config.size(); k++)
+  {
+    const auto &cam = config[k];
+    const auto &ref = cam.objects[to_underlying(objectType::REFERENCE_OBJ)];
+    const int top = depth_height * k;
+    cv::Mat temp;
+
+    matRoi = cv::Rect(0, top, depth_width, depth_height);
+    resize(cam.img_base, temp, cv::Size(depth_width, depth_height));
+    temp.copyTo(configScreen(matRoi));
+
+    matRoi = cv::Rect(depth_width, top, depth_width, depth_height);
+    resize(ref.imgDepth, temp, cv::Size(depth_width, depth_height));
+    cv::putText(temp,
+                fmt::format("object {}x{} pixels ", ref.area.w, ref.area.h),
+                { depth_width / 10, 50 },
+                cv::FONT_HERSHEY_PLAIN,
+                2,
+                cv::Scalar::all(0),
+                3,
+                5);
+    temp.copyTo(configScreen(matRoi));
+  }
 
   cv::imshow("config", configScreen);
 }
@@ -1,16 +1,17 @@
 #pragma once
 #include "image_utils.hpp"
 #include "objects.hpp"
+#include "height_map.h"
+#include "oriented_box.h"
 #include <cmath>
 #include <fmt/format.h>
 #include <memory>
 class detector
 {
 public:
-  static inline constexpr int maxKinectCount = 2;
   static inline const double box_size = 0.5;
   // public methods
-  detector();
+  explicit detector(size_t cameras);
   bbox
   detect(int kinectID,
          byte *frame_object,
@@ -21,9 +22,31 @@ public:
             const objectType t,
             const cv::Mat &imgDepth,
             const bbox &a,
-            const farsight::PointArray &flattened);
+            const farsight::PointCloud &flattened,
+            const farsight::ClusterStats &stats);
   cv::RotatedRect 
   calcBiggestComponent();
+  // Box of the reference object over all cameras, without the point
+  // cloud dumps of calcBiggestComponent. Empty until every camera has
+  // the reference object configured.
+  farsight::OrientedBox
+  measureBox();
+  // Volume and footprint under the top surface of the reference object,
+  // on a height map laid under box
+  farsight::HeightMapStats
+  measureVolume(const farsight::OrientedBox &box);
+  // Largest height map cell in meters
+  void
+  setHeightMapCell(float size)
+  {
+    heightMapCell = size;
+  }
+  // Top view footprint in millimeters, width along the first box axis
+  static cv::RotatedRect
+  topView(const farsight::OrientedBox &box);
+  // Top of the box above the floor the clouds were clipped at
+  static double
+  heightAboveFloor(const farsight::OrientedBox &box);
   void
   displayCurrectConfig();
   void
@@ -80,10 +103,18 @@ public:
     return c.camRot;
   }
 
+  // Cameras are mounted in facing pairs, 0 with 1, 2 with 3 and so on
+  int
+  getOppositeCamera(int kinectID) const
+  {
+    size_t opposite = kinectID ^ 1;
+    return opposite < config.size() ? opposite : kinectID;
+  }
+
   double calcMaxDistance()
   {
     auto &c1 = config[0];
-    auto &c2 = config[1];
+    auto &c2 = config[getOppositeCamera(0)];
     distance = c1.camPose.z + c2.camPose.z + box_size;
     return distance;
   }
@@ -126,6 +157,13 @@ public:
   {
       auto &c = config[kinectID];
       img.copyTo(c.img_base);
+      c.hasBase = true;
+  }
+
+  bool
+  hasBaseDepthImg(int kinectID) const
+  {
+    return config[kinectID].hasBase;
   }
 
   void
@@ -148,9 +186,13 @@ public:
 
 private:
   cv::Ptr<cv::SimpleBlobDetector> det;
-  std::array<cameraConfig, maxKinectCount> config;
+  // sized once, frames inside cameraConfig must not be copied
+  std::vector<cameraConfig> config;
   cv::Mat configScreen;
   cv::Rect matRoi;
   farsight::Point3f cameraOffsets;
   double distance = 0;
+  float heightMapCell = 0.01f;
+  // grid reused by every measureVolume
+  farsight::HeightMap heightMap;
 };
@@ -86,3 +86,81 @@ kinect::~kinect()
     this->close();
   }
 }
+
+kinectStreams::kinectStreams(int count)
+  : latest(count)
+  , fresh(count, false)
+{
+  // every device gets its own context, each kinect holds one
+  for (int i = 0; i < count; i++)
+    devices.push_back(std::make_unique<kinect>(i));
+
+  for (int i = 0; i < count; i++)
+    threads.emplace_back(&kinectStreams::capture, this, i);
+}
+
+kinectStreams::~kinectStreams()
+{
+  running = false;
+  arrived.notify_all();
+  for (auto &t : threads)
+    t.join();
+}
+
+void
+kinectStreams::capture(size_t k)
+{
+  auto &dev = *devices[k];
+  depthFrame frame;
+
+  while (running)
+  {
+    if (!dev.waitForFrames(1))
+      continue;
+
+    auto arrival = clock::now();
+    auto depth = dev.frames[libfreenect2::Frame::Depth];
+    auto data = reinterpret_cast<const float *>(depth->data);
+
+    frame.data.assign(data, data + depth->width * depth->height);
+    frame.width = depth->width;
+    frame.height = depth->height;
+    frame.sequence = depth->sequence;
+    frame.arrival = arrival;
+    dev.releaseFrames();
+
+    {
+      std::unique_lock lck{ lock };
+      std::swap(latest[k], frame);
+      fresh[k] = true;
+    }
+    arrived.notify_all();
+  }
+}
+
+bool
+kinectStreams::waitForPair(std::vector<depthFrame> &pair,
+                           std::chrono::milliseconds timeout)
+{
+  std::unique_lock lck{ lock };
+  auto ready = [&] {
+    for (bool f : fresh)
+    {
+      if (!f)
+        return false;
+    }
+    return true;
+  };
+
+  if (!arrived.wait_for(lck, timeout, ready))
+    return false;
+
+  // buffers go back and forth, no allocation once they are all sized
+  pair.resize(latest.size());
+  for (size_t k = 0; k < latest.size(); k++)
+  {
+    std::swap(pair[k], latest[k]);
+    fresh[k] = false;
+  }
+  return true;
+}
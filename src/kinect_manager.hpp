@@ -1,4 +1,11 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <libfreenect2/frame_listener_impl.h>
 #include <libfreenect2/libfreenect2.hpp>
 #include <libfreenect2/logger.h>
@@ -12,6 +19,12 @@ struct kinect
   ~kinect();
   bool
   open(int d_idx);
+  // Connected devices, at least one since the constructor opens one
+  int
+  countDevices()
+  {
+    return freenect2.enumerateDevices();
+  }
   bool
   waitForFrames(int sec);
   void
@@ -52,3 +65,47 @@ struct kinect
   libfreenect2::Freenect2Device *dev;
   libfreenect2::Freenect2 freenect2;
 };
+
+// Streams every connected device at once for continuous measurement.
+// A thread per device copies each depth frame out as soon as it arrives
+// and keeps only the newest one, a slow consumer skips frames instead of
+// falling behind the cameras.
+struct kinectStreams
+{
+  using clock = std::chrono::steady_clock;
+
+  struct depthFrame
+  {
+    // depth in millimeters, width * height floats
+    std::vector<float> data;
+    size_t width = 0, height = 0;
+    uint32_t sequence = 0;
+    clock::time_point arrival;
+  };
+
+  explicit kinectStreams(int count);
+  ~kinectStreams();
+
+  // Newest frame of every device, each newer than the one of the previous
+  // pair. False when no such pair arrived within timeout.
+  bool
+  waitForPair(std::vector<depthFrame> &pair, std::chrono::milliseconds timeout);
+
+  size_t
+  size() const
+  {
+    return devices.size();
+  }
+
+private:
+  void
+  capture(size_t k);
+
+  std::vector<std::unique_ptr<kinect>> devices;
+  std::vector<depthFrame> latest;
+  std::vector<bool> fresh;
+  std::vector<std::thread> threads;
+  std::mutex lock;
+  std::condition_variable arrived;
+  std::atomic<bool> running = true;
+};
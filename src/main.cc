@@ -1,4 +1,5 @@
 #include <cmath>
+#include <cstdlib>
 #include <limits>
 #include <memory>
 #include <mutex>
@@ -6,10 +7,19 @@
 
 #include "3d.h"
 #include "camera.h"
+#include "cloud_dump.h"
+#include "depth_rays.h"
 #include "filter.h"
+#include "frame_arena.h"
+#include "heap_counter.h"
 #include "image_proc.hpp"
 #include "kinect_manager.hpp"
+#include "measurement_stream.h"
+#include "object_cloud.h"
+#include "offscreen_view.h"
 #include "types.h"
+#include "voxel_grid.h"
+#include "worker_pool.h"
 #include <chrono>
 #include <fmt/ostream.h>
 #include <libfreenect2/registration.h>
@@ -39,7 +49,26 @@ struct shared_t
 };
 static farsight::postprocessing::Stage1 stage1(depth_width, depth_height);
 static std::vector<int> ids;
+// Temporaries of one measurement step, reset before every 'r' step.
+// Declared before the classifier, which is destroyed first.
+static farsight::FrameArena frameArena(64 << 20);
 static DisjointSet classifier;
+// Per camera state, sized once the connected devices are counted
+// Clusters kept between frames of every camera in incremental mode
+static std::vector<DisjointSet> trackedClassifier;
+static std::vector<farsight::DepthRays> depthRays;
+// Created on the first scene snapshot, works without an X display
+static std::unique_ptr<farsight::OffscreenView> offscreenView;
+static int sceneSnapshots = 0;
+// Continuous measurement streams all cameras at once, k_dev is closed
+// meanwhile. Buffers are per camera and reused for every pair.
+static int continuousMeasurement = 0;
+static int latencyTargetMs = 33; // one frame at 30 fps
+static std::unique_ptr<kinectStreams> streams;
+static std::vector<kinectStreams::depthFrame> streamPair;
+static std::vector<std::vector<float>> streamWork;
+static std::vector<cv::Mat> streamImages;
+static std::vector<bbox> streamBoxes;
 
 constexpr int waitTime = 50;
 
@@ -47,6 +76,14 @@ const int floor_level_max = 1000;
 static int floor_level_raw = 0;
 static int disjointTreshold = 0;
 static int disjointSetValidSize= 0;
+static int voxelLeafSize = 0; // in milimeters
+static int incrementalClustering = 0;
+static int changeTolerance = 5; // in milimeters
+// Pixels incremental clustering redid and saw, since the last report
+static size_t reclusteredPixels = 0, trackedPixels = 0;
+static int dumpPointClouds = 0; // debugging only, off in production
+static int heightMapCell = 10; // in milimeters
+static farsight::VoxelGridParams voxelGrid;
 // Defining the dimensions of checkerboard
 static int CHECKERBOARD[2]{ 8, 6 };
 static cv::Mat cameraMatrix, distCoeffs;
@@ -69,7 +106,8 @@ static const std::vector<char> base_scenario = { '1', 'b', '2',
 static const std::vector<char> meassure_scenario = { '1', 'n', '2', 'n',
                                                      '1', 'r', '2', 'r',
                                                       'e' };
-glm::vec3 cam1_tvec = {0,0,0}, cam2_tvec = {0,0,0}, cam1_rvec = {0,0,0}, cam2_rvec = {0,0,0}; 
+// 3d view alignment of every camera
+std::vector<glm::vec3> cam_tvec, cam_rvec;
 std::atomic_flag continue_flag;
 std::vector<cv::String> images;
 std::vector<cv::String> images_ir;
@@ -343,14 +381,13 @@ findCameraOffsetDiff(const libfreenect2::Registration &reg,
 }
 
 void
-generateScene(const libfreenect2::Registration &reg,
+generateScene(const farsight::DepthRays &rays,
               const libfreenect2::Frame *f,
               const farsight::Point3f &tvec,
               const farsight::Point3f &rvec,
               const int cam)
 {
-  farsight::Point3f p{ 0, 0, 0 };
-  farsight::PointArray pointMap;
+  farsight::PointCloud pointMap;
 
   if (!tvecs.size() || !rvecs.size())
     return;
@@ -371,37 +408,32 @@ generateScene(const libfreenect2::Registration &reg,
     }
   }
 
-  int pos;
-  for (int r = 0; r < f->height; r++)
-  {
-    for (int c = 0; c < f->width; c++)
-    {
-      pos = r * f->width + c;
-      reg.getPointXYZ(f, r, c, p.x, p.y, p.z);
-
-      if (p.z < 4.5)
-      {
-        pointMap.push_back({ p.x, p.y, p.z });
-      }
-      else
-      {
-        pointMap.push_back({NAN, NAN, NAN});
-      }
-    }
-  }
+  rays.project(reinterpret_cast<const float *>(f->data),
+               0,
+               0,
+               f->width,
+               f->height,
+               pointMap,
+               4.5f,
+               &farsight::worker_pool());
+  pointMap = farsight::voxel_downsample(pointMap, voxelGrid);
   fmt::print("Updating opengl\n");
   fmt::print("tvec {} {} {} \n", gtvec.x, gtvec.y, gtvec.z);
-  farsight::camera2real(pointMap, gtvec, grmat, ids[0]);
-  if (cam == 0)
-    farsight::update_points_cam1(pointMap, depth_width);
-  else
-    farsight::update_points_cam2(pointMap, depth_width);
+  farsight::camera2real(
+    pointMap, gtvec, grmat, ids[0], &farsight::worker_pool());
+  farsight::update_points(cam, pointMap);
+}
+
+static DisjointSet &
+activeClassifier(int cam)
+{
+  return incrementalClustering ? trackedClassifier[cam] : classifier;
 }
 
 // return array of points with mapped
 // the real x y z coordinates in milimiters
-farsight::PointArray
-createPointMaping(const libfreenect2::Registration &reg,
+farsight::PointCloud
+createPointMaping(const farsight::DepthRays &rays,
                   const libfreenect2::Frame *f,
                   const byte *filtered,
                   const bbox &b,
@@ -409,11 +441,9 @@ createPointMaping(const libfreenect2::Registration &reg,
                   const farsight::Point3f &rvec,
                   const int id,
                   int cam,
-                  double distance)
+                  double distance,
+                  std::pmr::memory_resource *resource)
 {
-  farsight::Point3f p{ 0, 0, 0 };
-  classifier.reset();
-
   glm::vec3 gtvec = { tvec.x, tvec.y, tvec.z };
   cv::Vec3d rvec3d  = { rvec.x, rvec.y, rvec.z };
 
@@ -430,56 +460,44 @@ createPointMaping(const libfreenect2::Registration &reg,
       grmat[r][c] = d;
     }
   }
-  int pos;
-  farsight::PointArray pointMap;
-  for (size_t r = b.y; r < b.y + b.h; r++)
-  {
-    for (size_t c = b.x; c < b.x + b.w; c++)
-    {
-      pos = r * b.w + c;
-      reg.getPointXYZ(f, r, c, p.x, p.y, p.z);
-      pointMap.push_back({ p.x, p.y, p.z });
-    }
-  }
 
-  farsight::camera2real(pointMap, gtvec, grmat, id);
-  if (cam == 0)
-  {
-    farsight::set_tvec_cam1(cam1_tvec);
-    farsight::set_rvec_cam1(cam1_rvec);
-    farsight::update_points_cam1(pointMap, depth_width);
-    pointMap = farsight::get_translated_points_cam1();
-  }
-  else
-  {
-    farsight::set_tvec_cam2(cam2_tvec);
-    farsight::set_rvec_cam2(cam2_rvec);
-    farsight::update_points_cam2(pointMap, depth_width);
-    pointMap = farsight::get_translated_points_cam2();
-  }
-  for(auto &p : pointMap)
+  // Camera to world and 3d view alignment composed into one transform
+  const auto &gl_tvec = cam_tvec[cam];
+  const auto &gl_rvec = cam_rvec[cam];
+  auto world = farsight::compose_transform(
+    farsight::pose_transform(gl_tvec, gl_rvec),
+    farsight::camera_transform(gtvec, grmat, id));
+
+  farsight::ObjectCloudParams params;
+  params.floor_level = farsight::get_floor_level();
+  params.max_z = distance;
+  params.incremental = incrementalClustering;
+  params.tolerance = changeTolerance / 1000.0;
+  params.voxels = voxelGrid;
+
+  size_t reclustered = 0;
+  auto pointMap =
+    farsight::object_cloud(rays,
+                           reinterpret_cast<const float *>(f->data),
+                           b.x,
+                           b.y,
+                           b.w,
+                           b.h,
+                           world,
+                           params,
+                           activeClassifier(cam),
+                           &farsight::worker_pool(),
+                           resource,
+                           &reclustered);
+  if (incrementalClustering)
   {
-    if(p.z > distance)
-        classifier.addPoint({NAN,NAN,NAN});
-    else
-        classifier.addPoint(p); 
+    reclusteredPixels += reclustered;
+    trackedPixels += size_t(b.w) * b.h;
   }
 
-  auto cat_sizes = classifier.countCategories();
-  pointMap = classifier.getPointsByDelimiter(cat_sizes);
-
-  if (cam == 0)
-  {
-    farsight::set_tvec_cam1({0,0,0});
-    farsight::set_rvec_cam1({0,0,0});
-    farsight::update_points_cam1(pointMap, depth_width);
-  }
-  else
-  {
-    farsight::set_tvec_cam2({0,0,0});
-    farsight::set_rvec_cam2({0,0,0});
-    farsight::update_points_cam2(pointMap, depth_width);
-  }
+  farsight::set_tvec(cam, {0,0,0});
+  farsight::set_rvec(cam, {0,0,0});
+  farsight::update_points(cam, pointMap);
   
   return pointMap;
 }
@@ -496,12 +514,249 @@ static void
 on_disjoint_treshold(int, void *)
 {
     classifier.updateTreshold(disjointTreshold/100.0);
+    for (auto &tracked : trackedClassifier)
+      tracked.updateTreshold(disjointTreshold/100.0);
 }
 
 static void
 on_disjoint_valid_size(int, void *)
 {
     classifier.updateValidSize(disjointSetValidSize);
+    for (auto &tracked : trackedClassifier)
+      tracked.updateValidSize(disjointSetValidSize);
+}
+
+static void
+on_voxel_leaf_size(int, void *)
+{
+    voxelGrid.leaf_size = voxelLeafSize / 1000.0f;
+    fmt::print("Voxel leaf size: {}\n", voxelGrid.leaf_size);
+}
+
+static void
+on_dump_point_clouds(int, void *)
+{
+  farsight::cloud_dumper().set_enabled(dumpPointClouds);
+}
+
+static void
+on_height_map_cell(int, void *userdata)
+{
+  // trackbars start at 0, cells do not
+  auto &dec = *static_cast<detector *>(userdata);
+  dec.setHeightMapCell(std::max(heightMapCell, 1) / 1000.0f);
+}
+
+static void
+on_latency_target(int, void *)
+{
+  farsight::measurement_stream().set_latency_target(latencyTargetMs);
+}
+
+// Footprint in millimeters as the floor marker of the 3d view
+static void
+markFootprint(const cv::RotatedRect &minRect, bool verbose)
+{
+  auto mass_center = minRect.center;
+  mass_center.x/=1000;
+  mass_center.y/=1000;
+  auto angle = minRect.angle;
+  double obj_width = minRect.size.width/1000.0;
+  double obj_height = minRect.size.height/1000.0;
+
+  farsight::Rectfc corners;
+  corners.verts[0] = {
+    static_cast<float>(mass_center.x + obj_width / 2),
+    0.0,
+    static_cast<float>(mass_center.y + obj_height / 2),
+    farsight::WHITE
+  };
+  corners.verts[1] = {
+    static_cast<float>(mass_center.x + obj_width / 2),
+    0.0,
+    static_cast<float>(mass_center.y - obj_height / 2),
+    farsight::WHITE
+  };
+  corners.verts[2] = {
+    static_cast<float>(mass_center.x - obj_width / 2),
+    0.0,
+    static_cast<float>(mass_center.y - obj_height / 2),
+    farsight::WHITE
+  };
+  corners.verts[3] = {
+    static_cast<float>(mass_center.x - obj_width / 2),
+    0.0,
+    static_cast<float>(mass_center.y + obj_height / 2),
+    farsight::WHITE
+  };
+  glm::vec3 rotRectMat = {0.0,(M_PI/180)*angle, 0.0};
+  if (verbose)
+  {
+    fmt::print("MASS CENETER {} {}\n", mass_center.x, mass_center.y);
+    fmt::print("RECT CORNER_1 {} {} {}\n", corners.verts[0].x, corners.verts[0].y, corners.verts[0].z);
+    fmt::print("RECT CORNER_2 {} {} {}\n", corners.verts[1].x, corners.verts[1].y, corners.verts[1].z);
+    fmt::print("RECT CORNER_3 {} {} {}\n", corners.verts[2].x, corners.verts[2].y, corners.verts[2].z);
+    fmt::print("RECT CORNER_4 {} {} {}\n", corners.verts[3].x, corners.verts[3].y, corners.verts[3].z);
+    fmt::print("Corner angle {}\n", rotRectMat.y);
+  }
+  farsight::reset_marks();
+  farsight::add_marker(corners, {0,0,0}, rotRectMat);
+}
+
+// Continuous mode needs what the scenarios set up first
+static bool
+canMeasureContinuously(detector &dec, int kinectCount)
+{
+  if (!arucoCalibrated)
+  {
+    fmt::print("Continuous measurement needs camera poses, press 'l'\n");
+    return false;
+  }
+  for (int i = 0; i < kinectCount; i++)
+  {
+    if (!dec.hasBaseDepthImg(i))
+    {
+      fmt::print("Continuous measurement needs base images, press 'b'\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+// The 'n' and 'r' steps of the measure scenario on the newest frames of
+// all cameras, then box fitting, published to the measurement stream.
+// Frames skip the temporal filter of the scenarios, incremental
+// clustering keeps the work of a quiet scene small instead. False when
+// no new pair arrived.
+static bool
+measureContinuously(detector &dec, double distance)
+{
+  if (!streams->waitForPair(streamPair, std::chrono::milliseconds(100)))
+    return false;
+
+  const size_t cameras = streamPair.size();
+  auto first = streamPair[0].arrival, last = first;
+  for (const auto &frame : streamPair)
+  {
+    first = std::min(first, frame.arrival);
+    last = std::max(last, frame.arrival);
+  }
+
+  frameArena.reset();
+  streamWork.resize(cameras);
+  streamImages.resize(cameras);
+  streamBoxes.resize(cameras);
+
+  // nearest points of all cameras first, mapping needs the opposite one
+  for (size_t k = 0; k < cameras; k++)
+  {
+    auto &frame = streamPair[k];
+    auto &work = streamWork[k];
+    work = frame.data;
+
+    libfreenect2::Frame processed(frame.width,
+                                  frame.height,
+                                  sizeof(float),
+                                  reinterpret_cast<byte *>(work.data()));
+    depthProcess(&processed);
+    conv32FC1To8CU1(processed.data, total_size_depth);
+    cv::Mat(depth_height, depth_width, CV_8UC1, processed.data)
+      .copyTo(streamImages[k]);
+
+    streamBoxes[k] =
+      dec.detect(k, processed.data, total_size_depth, streamImages[k]);
+    auto nearestPoint = findNearestPoint<float>(
+      streamBoxes[k],
+      reinterpret_cast<const byte *>(frame.data.data()),
+      processed.data);
+    dec.setNearestPoint(k, nearestPoint);
+  }
+
+  for (size_t k = 0; k < cameras; k++)
+  {
+    auto &frame = streamPair[k];
+    libfreenect2::Frame raw(frame.width,
+                            frame.height,
+                            sizeof(float),
+                            reinterpret_cast<byte *>(frame.data.data()));
+    const auto &np = dec.getNearestPoint(dec.getOppositeCamera(k));
+    auto realPoints =
+      createPointMaping(depthRays[k],
+                        &raw,
+                        reinterpret_cast<const byte *>(streamWork[k].data()),
+                        streamBoxes[k],
+                        dec.getCameraPos(k),
+                        dec.getCameraRot(k),
+                        dec.getCameraFaceID(k),
+                        k,
+                        distance - np.z,
+                        &frameArena);
+
+    dec.setConfig(k,
+                  objectType::REFERENCE_OBJ,
+                  streamImages[k],
+                  streamBoxes[k],
+                  realPoints,
+                  activeClassifier(k).getValidStats());
+  }
+
+  farsight::Measurement m;
+  m.box = dec.measureBox();
+  if (m.box.count == 0)
+    return true;
+
+  m.height = detector::heightAboveFloor(m.box);
+  auto volume = dec.measureVolume(m.box);
+  m.volume = volume.volume;
+  m.footprint = volume.footprint;
+  m.captured = first;
+  m.skew_ms = std::chrono::duration<double, std::milli>(last - first).count();
+  farsight::measurement_stream().publish(m);
+
+  markFootprint(detector::topView(m.box), false);
+  return true;
+}
+
+static void
+reportReclustering()
+{
+  if (trackedPixels)
+    fmt::print("Reclustered {} of {} pixels\n",
+               reclusteredPixels,
+               trackedPixels);
+  reclusteredPixels = 0;
+  trackedPixels = 0;
+}
+
+static void
+reportMeasurements()
+{
+  reportReclustering();
+
+  auto &stream = farsight::measurement_stream();
+  auto m = stream.latest();
+  if (!m)
+    return;
+
+  auto stats = stream.get_latency_stats();
+  fmt::print("Measurement {}: {:.0f} x {:.0f} x {:.0f} mm, {:.2f} l, "
+             "footprint {:.1f} cm2, skew {:.1f} ms\n",
+             m->sequence,
+             m->box.extents.x * 1000,
+             m->box.extents.y * 1000,
+             m->height * 1000,
+             m->volume * 1000,
+             m->footprint * 10000,
+             m->skew_ms);
+  fmt::print("Latency {:.1f} Hz, mean {:.1f} p95 {:.1f} max {:.1f} ms, "
+             "{} of {} over the {:.0f} ms target\n",
+             stats.rate_hz,
+             stats.mean_ms,
+             stats.p95_ms,
+             stats.max_ms,
+             stats.over_target,
+             stats.published,
+             stats.target_ms);
 }
 
 void calibrateCamera(kinect &dev)
@@ -526,6 +781,7 @@ void calibrateCamera(kinect &dev)
   dev.open(0);
   dev.setIRParams(ir_params);
   dev.setColorParams(color_params);
+  depthRays[0].rebuild(ir_params, depth_width, depth_height);
   //dev.open(1);
   //dev.setIRParams(ir_params);
 }
@@ -548,20 +804,42 @@ main(int argc, char **argv)
   int filterCounter = 0;
   auto scenario_iter = base_scenario.end() - 1;
 
-  std::thread gl_thread(farsight::init3d);
-  gl_thread.detach();
-  detector dec;
+  // Without a display the scene is only rendered offscreen on request
+  if (getenv("DISPLAY"))
+  {
+    std::thread gl_thread(farsight::init3d);
+    gl_thread.detach();
+  }
+  else
+    fmt::print("No display, 3D view disabled, 'v' saves scene images\n");
   kinect k_dev(0);
-  auto irParams0 = k_dev.getIRParams();
-  auto colorParams0 = k_dev.getColorParams();
-  k_dev.open(1);
-  auto irParams1 = k_dev.getIRParams();
-  auto colorParams1 = k_dev.getColorParams();
-
-  libfreenect2::Registration reg[2]{{irParams0, colorParams0}, {irParams1, colorParams1}};
+  const int kinectCount = k_dev.countDevices();
+  detector dec(kinectCount);
+
+  farsight::set_camera_count(kinectCount);
+  trackedClassifier.resize(kinectCount);
+  // clusters of the last step live in the arena until the next one
+  frameArena.on_reset([] { classifier.reset(); });
+  depthRays.resize(kinectCount);
+  cam_tvec.assign(kinectCount, {0,0,0});
+  cam_rvec.assign(kinectCount, {0,0,0});
+
+  // Registration is not copyable, it stays at one address
+  std::vector<std::unique_ptr<libfreenect2::Registration>> reg;
+  for (int i = 0; i < kinectCount; i++)
+  {
+    k_dev.open(i);
+    auto irParams = k_dev.getIRParams();
+    auto colorParams = k_dev.getColorParams();
+
+    reg.push_back(
+      std::make_unique<libfreenect2::Registration>(irParams, colorParams));
+    depthRays[i].rebuild(irParams, depth_width, depth_height);
+    assert(depthRays[i].matches(*reg[i], 1e-4f));
+  }
   k_dev.open(selectedKinnect);
 
-  shared_t shared{std::mutex(), reg[selectedKinnect]};
+  shared_t shared{std::mutex(), *reg[selectedKinnect]};
   cv::namedWindow(wndname2, cv::WINDOW_AUTOSIZE);
   cv::setMouseCallback(wndname2, mouse_event_handler, &shared);
 
@@ -581,10 +859,83 @@ main(int argc, char **argv)
                  &disjointSetValidSize,
                  300,
                  on_disjoint_valid_size);
+  createTrackbar("Voxel leaf size [mm]",
+                 "floor",
+                 &voxelLeafSize,
+                 50,
+                 on_voxel_leaf_size);
+  createTrackbar("Incremental clustering",
+                 "floor",
+                 &incrementalClustering,
+                 1);
+  createTrackbar("Change tolerance [mm]",
+                 "floor",
+                 &changeTolerance,
+                 50);
+  createTrackbar("Continuous measurement",
+                 "floor",
+                 &continuousMeasurement,
+                 1);
+  createTrackbar("Latency target [ms]",
+                 "floor",
+                 &latencyTargetMs,
+                 200,
+                 on_latency_target);
+  on_latency_target(latencyTargetMs, nullptr);
+  createTrackbar("Height map cell [mm]",
+                 "floor",
+                 &heightMapCell,
+                 50,
+                 on_height_map_cell,
+                 &dec);
+  on_height_map_cell(heightMapCell, &dec);
+  createTrackbar("Dump point clouds",
+                 "floor",
+                 &dumpPointClouds,
+                 1,
+                 on_dump_point_clouds);
+  auto lastReport = std::chrono::steady_clock::now();
 
   byte *depth_backup = nullptr;
   while (continue_flag.test_and_set() and c != 'q')
   {
+    // devices move between k_dev and the streams of all cameras
+    if (continuousMeasurement && !streams)
+    {
+      if (canMeasureContinuously(dec, kinectCount))
+      {
+        k_dev.close();
+        streams = std::make_unique<kinectStreams>(kinectCount);
+        on_latency_target(latencyTargetMs, nullptr);
+      }
+      else
+        setTrackbarPos("Continuous measurement", "floor", 0);
+    }
+    else if (!continuousMeasurement && streams)
+    {
+      streams.reset();
+      k_dev.open(selectedKinnect);
+    }
+
+    if (streams)
+    {
+      if (measureContinuously(dec, distance))
+        cv::imshow(wndname2, streamImages[selectedKinnect]);
+
+      auto now = std::chrono::steady_clock::now();
+      if (now - lastReport >= std::chrono::seconds(1))
+      {
+        reportMeasurements();
+        lastReport = now;
+      }
+
+      // keys only pick the camera shown, waiting longer costs frames
+      c = cv::waitKey(1);
+      if (c >= '1' && c - '1' < kinectCount)
+        selectedKinnect = c - '1';
+      continue;
+    }
+
     k_dev.waitForFrames(10);
 
     rgb = k_dev.frames[libfreenect2::Frame::Color];
@@ -630,7 +981,7 @@ main(int argc, char **argv)
             dec.setCameraPos(selectedKinnect, pos);
             dec.setCameraRot(selectedKinnect, rot);
             distance = dec.calcMaxDistance();
-            generateScene(reg[selectedKinnect], depth, pos, rot, selectedKinnect);
+            generateScene(depthRays[selectedKinnect], depth, pos, rot, selectedKinnect);
         }
       }
     }
@@ -657,48 +1008,34 @@ main(int argc, char **argv)
         storage << "distCoeffs" << distCoeffs;
         storage << "cameraMatrixIR" << cameraMatrixIR;
         storage << "distCoeffsIR" << distCoeffsIR;
-        const auto &pos1 = dec.getCameraPos(0);
-        tvec[0] = pos1.x;
-        tvec[1] = pos1.y;
-        tvec[2] = pos1.z;
-        storage << "tvec_cam1" << tvec;
-        const auto &pos2 = dec.getCameraPos(1);
-        tvec[0] = pos2.x;
-        tvec[1] = pos2.y;
-        tvec[2] = pos2.z;
-        storage << "tvec_cam2" << tvec;
-
-        const auto &rot1 = dec.getCameraRot(0);
-        rvec[0] = rot1.x;
-        rvec[1] = rot1.y;
-        rvec[2] = rot1.z;
-        storage << "rvec_cam1" << rvec;
-        const auto &rot2 = dec.getCameraRot(1);
-        rvec[0] = rot2.x;
-        rvec[1] = rot2.y;
-        rvec[2] = rot2.z;
-        storage << "rvec_cam2" << rvec;
-
-        tvec[0] = cam1_tvec.x;
-        tvec[1] = cam1_tvec.y;
-        tvec[2] = cam1_tvec.z;
-        storage << "glvec_cam1" << tvec;
-        tvec[0] = cam2_tvec.x;
-        tvec[1] = cam2_tvec.y;
-        tvec[2] = cam2_tvec.z;
-        storage << "glvec_cam2" << tvec;
-
-        tvec[0] = cam1_rvec.x;
-        tvec[1] = cam1_rvec.y;
-        tvec[2] = cam1_rvec.z;
-        storage << "glrot_cam1" << tvec;
-        tvec[0] = cam2_rvec.x;
-        tvec[1] = cam2_rvec.y;
-        tvec[2] = cam2_rvec.z;
-        storage << "glrot_cam2" << tvec;
-
-        storage << "face_id_1" << dec.getCameraFaceID(0);
-        storage << "face_id_2" << dec.getCameraFaceID(1);
+        // keys are numbered from 1, as for the first two cameras before
+        for (int i = 0; i < kinectCount; i++)
+        {
+          const auto &pos = dec.getCameraPos(i);
+          tvec[0] = pos.x;
+          tvec[1] = pos.y;
+          tvec[2] = pos.z;
+          storage << fmt::format("tvec_cam{}", i + 1) << tvec;
+
+          const auto &rot = dec.getCameraRot(i);
+          rvec[0] = rot.x;
+          rvec[1] = rot.y;
+          rvec[2] = rot.z;
+          storage << fmt::format("rvec_cam{}", i + 1) << rvec;
+
+          tvec[0] = cam_tvec[i].x;
+          tvec[1] = cam_tvec[i].y;
+          tvec[2] = cam_tvec[i].z;
+          storage << fmt::format("glvec_cam{}", i + 1) << tvec;
+
+          tvec[0] = cam_rvec[i].x;
+          tvec[1] = cam_rvec[i].y;
+          tvec[2] = cam_rvec[i].z;
+          storage << fmt::format("glrot_cam{}", i + 1) << tvec;
+
+          storage << fmt::format("face_id_{}", i + 1)
+                  << dec.getCameraFaceID(i);
+        }
         storage << "distance" << distance;
         storage << "floor_level" << floor_level;
         calibrateCamera(k_dev);
@@ -716,51 +1053,32 @@ main(int argc, char **argv)
         storage["distCoeffs"] >> distCoeffs;
         storage["cameraMatrixIR"] >> cameraMatrixIR;
         storage["distCoeffsIR"] >> distCoeffsIR;
-        storage["tvec_cam1"] >> vec;
-        pos.x = vec[0];
-        pos.y = vec[1];
-        pos.z = vec[2];
-        dec.setCameraPos(0, pos);
-        storage["tvec_cam2"] >> vec;
-        pos.x = vec[0];
-        pos.y = vec[1];
-        pos.z = vec[2];
-        dec.setCameraPos(1, pos);
-        storage["rvec_cam1"] >> vec;
-        pos.x = vec[0];
-        pos.y = vec[1];
-        pos.z = vec[2];
-        dec.setCameraRot(0, pos);
-        storage["rvec_cam2"] >> vec;
-        pos.x = vec[0];
-        pos.y = vec[1];
-        pos.z = vec[2];
-        dec.setCameraRot(1, pos);
-        storage["glvec_cam1"] >> vec;
-        cam1_tvec.x = vec[0];
-        cam1_tvec.y = vec[1];
-        cam1_tvec.z = vec[2];
-        farsight::set_tvec_cam1(cam1_tvec);
-        storage["glvec_cam2"] >> vec;
-        cam2_tvec.x = vec[0];
-        cam2_tvec.y = vec[1];
-        cam2_tvec.z = vec[2];
-        farsight::set_tvec_cam2(cam2_tvec);
-        storage["glrot_cam1"] >> vec;
-        cam1_rvec.x = vec[0];
-        cam1_rvec.y = vec[1];
-        cam1_rvec.z = vec[2];
-        farsight::set_rvec_cam1(cam1_rvec);
-        storage["glrot_cam2"] >> vec;
-        cam2_rvec.x = vec[0];
-        cam2_rvec.y = vec[1];
-        cam2_rvec.z = vec[2];
-        farsight::set_rvec_cam2(cam2_rvec);
+        for (int i = 0; i < kinectCount; i++)
+        {
+          storage[fmt::format("tvec_cam{}", i + 1)] >> vec;
+          pos.x = vec[0];
+          pos.y = vec[1];
+          pos.z = vec[2];
+          dec.setCameraPos(i, pos);
+          storage[fmt::format("rvec_cam{}", i + 1)] >> vec;
+          pos.x = vec[0];
+          pos.y = vec[1];
+          pos.z = vec[2];
+          dec.setCameraRot(i, pos);
+          storage[fmt::format("glvec_cam{}", i + 1)] >> vec;
+          cam_tvec[i].x = vec[0];
+          cam_tvec[i].y = vec[1];
+          cam_tvec[i].z = vec[2];
+          farsight::set_tvec(i, cam_tvec[i]);
+          storage[fmt::format("glrot_cam{}", i + 1)] >> vec;
+          cam_rvec[i].x = vec[0];
+          cam_rvec[i].y = vec[1];
+          cam_rvec[i].z = vec[2];
+          farsight::set_rvec(i, cam_rvec[i]);
+          storage[fmt::format("face_id_{}", i + 1)] >> faceid;
+          dec.setCameraFaceID(i, faceid);
+        }
         //calibrateCamera(k_dev);  
-        storage["face_id_1"] >> faceid;
-        dec.setCameraFaceID(0, faceid);
-        storage["face_id_2"] >> faceid;
-        dec.setCameraFaceID(1, faceid);
         storage["distance"] >> distance;
         storage["floor_level"] >> floor_level;
         storage.release();
@@ -768,22 +1086,43 @@ main(int argc, char **argv)
       }
       break;
       case 'x':
-        cam1_tvec += farsight::get_tvec_cam1();
-        cam1_rvec += farsight::get_rvec_cam1();
-        cam2_tvec += farsight::get_tvec_cam2();
-        cam2_rvec += farsight::get_rvec_cam2();
-        farsight::set_tvec_cam1({0,0,0});
-        farsight::set_tvec_cam1({0,0,0});
-        farsight::set_rvec_cam2({0,0,0});
-        farsight::set_rvec_cam2({0,0,0});
+        for (int i = 0; i < kinectCount; i++)
+        {
+          cam_tvec[i] += farsight::get_tvec(i);
+          cam_rvec[i] += farsight::get_rvec(i);
+          farsight::set_tvec(i, {0,0,0});
+          farsight::set_rvec(i, {0,0,0});
+        }
+      break;
+      case 'v': {
+        if (!offscreenView)
+          offscreenView = std::make_unique<farsight::OffscreenView>(640, 480);
+
+        auto image = offscreenView->render(
+          farsight::context3D, {2.5f, 2.0f, 2.5f}, {0.0f, 0.0f, 0.0f});
+        if (image.empty())
+        {
+          fmt::print("Offscreen view failed: {}\n",
+                     offscreenView->get_error());
+          break;
+        }
+
+        auto path = fmt::format("scene_{}.png", sceneSnapshots++);
+        cv::imwrite(path, image);
+        fmt::print("Scene saved to {}\n", path);
+      }
       break;
       case '1':
-        if (k_dev.open(0))
-          selectedKinnect = 0;
-        break;
       case '2':
-        if (k_dev.open(1))
-          selectedKinnect = 1;
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+        if (c - '1' < kinectCount && k_dev.open(c - '1'))
+          selectedKinnect = c - '1';
         break;
     }
 
@@ -805,6 +1144,8 @@ main(int argc, char **argv)
       }
       break;
       case 'r': {
+        frameArena.reset();
+        farsight::HeapCounter heapCounter;
         auto depth_cpy = image_depth.clone();
         dec.saveDepthFrame(selectedKinnect, objectType::REFERENCE_OBJ, &depth_frame_cpy);
         const auto faceid = dec.getCameraFaceID(selectedKinnect);
@@ -812,10 +1153,10 @@ main(int argc, char **argv)
         const auto &rot = dec.getCameraRot(selectedKinnect);
         auto detectedBox = dec.detect(
           selectedKinnect, depth->data, total_size_depth, depth_cpy);
-        const auto &np = dec.getNearestPoint(selectedKinnect == 0 ? 1 : 0);
+        const auto &np = dec.getNearestPoint(dec.getOppositeCamera(selectedKinnect));
         double dist = distance - np.z;
         fmt::print("Distance {}, nearest point {}\n", dist, np.z);
-        auto realPoints = createPointMaping(reg[selectedKinnect],
+        auto realPoints = createPointMaping(depthRays[selectedKinnect],
                                             &depth_frame_cpy,
                                             depth->data,
                                             detectedBox,
@@ -823,53 +1164,35 @@ main(int argc, char **argv)
                                             rot,
                                             faceid,
                                             selectedKinnect,
-                                            dist);
-
-        dec.setConfig(
-          selectedKinnect, objectType::REFERENCE_OBJ, depth_cpy, detectedBox, realPoints);
+                                            dist,
+                                            &frameArena);
+
+        dec.setConfig(selectedKinnect,
+                      objectType::REFERENCE_OBJ,
+                      depth_cpy,
+                      detectedBox,
+                      realPoints,
+                      activeClassifier(selectedKinnect).getValidStats());
         dec.displayCurrectConfig();
         auto minRect = dec.calcBiggestComponent();
-        auto mass_center = minRect.center;
-        mass_center.x/=1000;
-        mass_center.y/=1000;
-        auto angle = minRect.angle;
-        double obj_width = minRect.size.width/1000.0;
-        double obj_height = minRect.size.height/1000.0;
-        fmt::print("MASS CENETER {} {}\n", mass_center.x, mass_center.y);
-
-        farsight::Rectfc corners;
-        corners.verts[0] = {
-          static_cast<float>(mass_center.x + obj_width / 2),
-          0.0,
-          static_cast<float>(mass_center.y + obj_height / 2),
-          farsight::WHITE
-        };
-        corners.verts[1] = {
-          static_cast<float>(mass_center.x + obj_width / 2),
-          0.0,
-          static_cast<float>(mass_center.y - obj_height / 2),
-          farsight::WHITE
-        };
-        corners.verts[2] = {
-          static_cast<float>(mass_center.x - obj_width / 2),
-          0.0,
-          static_cast<float>(mass_center.y - obj_height / 2),
-          farsight::WHITE
-        };
-        corners.verts[3] = {
-          static_cast<float>(mass_center.x - obj_width / 2),
-          0.0,
-          static_cast<float>(mass_center.y + obj_height / 2),
-          farsight::WHITE
-        };
-        glm::vec3 rotRectMat = {0.0,(M_PI/180)*angle, 0.0};
-        fmt::print("RECT CORNER_1 {} {} {}\n", corners.verts[0].x, corners.verts[0].y, corners.verts[0].z);
-        fmt::print("RECT CORNER_2 {} {} {}\n", corners.verts[1].x, corners.verts[1].y, corners.verts[1].z);
-        fmt::print("RECT CORNER_3 {} {} {}\n", corners.verts[2].x, corners.verts[2].y, corners.verts[2].z);
-        fmt::print("RECT CORNER_4 {} {} {}\n", corners.verts[3].x, corners.verts[3].y, corners.verts[3].z);
-        fmt::print("Corner angle {}\n", rotRectMat.y);
-        farsight::reset_marks();
-        farsight::add_marker(corners, {0,0,0}, rotRectMat);
+        reportReclustering();
+        auto stepHeap = heapCounter.thread();
+        auto processHeap = heapCounter.process();
+        fmt::print("Frame arena: {} allocations, {}/{} bytes, "
+                   "{} spilled to the heap ({} bytes)\n",
+                   frameArena.get_allocations(),
+                   frameArena.get_used(),
+                   frameArena.get_capacity(),
+                   frameArena.heap_allocations(),
+                   frameArena.heap_bytes());
+        if (farsight::heap_counting)
+          fmt::print("Heap: {} allocations ({} bytes) in the step, "
+                     "{} ({} bytes) in the whole process meanwhile\n",
+                     stepHeap.allocations,
+                     stepHeap.bytes,
+                     processHeap.allocations,
+                     processHeap.bytes);
+        markFootprint(minRect, true);
       }
       break;
       case '1':
@@ -916,5 +1239,7 @@ main(int argc, char **argv)
     }
     k_dev.releaseFrames();
   }
-  k_dev.close();
+  streams.reset();
+  if (k_dev.isActive)
+    k_dev.close();
 }
@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include "measurement_stream.h"
+
+namespace farsight {
+
+  void
+  MeasurementStream::publish(Measurement m)
+  {
+    auto now = Clock::now();
+    m.latency_ms =
+      std::chrono::duration<double, std::milli>(now - m.captured).count();
+
+    std::unique_lock lck{ mtx };
+    m.sequence = ++sequence;
+
+    // slots fill up in order, then the oldest one is overwritten
+    size_t slot = (m.sequence - 1) % history;
+    if (latencies.size() < history)
+    {
+      latencies.push_back(m.latency_ms);
+      published.push_back(now);
+    }
+    else
+    {
+      latencies[slot] = m.latency_ms;
+      published[slot] = now;
+    }
+
+    since_target++;
+    if (target_ms > 0 && m.latency_ms > target_ms)
+      over_target++;
+
+    std::atomic_store(&current, Ptr(std::make_shared<const Measurement>(m)));
+    lck.unlock();
+
+    next.notify_all();
+  }
+
+  MeasurementStream::Ptr
+  MeasurementStream::wait_next(uint64_t after,
+                               std::chrono::milliseconds timeout) const
+  {
+    std::unique_lock lck{ mtx };
+    if (!next.wait_for(lck, timeout, [&] { return sequence > after; }))
+      return nullptr;
+
+    return latest();
+  }
+
+  void
+  MeasurementStream::set_latency_target(double ms)
+  {
+    std::unique_lock lck{ mtx };
+    target_ms = ms;
+    over_target = 0;
+    since_target = 0;
+  }
+
+  LatencyStats
+  MeasurementStream::get_latency_stats() const
+  {
+    LatencyStats stats;
+    std::vector<double> sorted;
+    Clock::time_point oldest, newest;
+
+    {
+      std::unique_lock lck{ mtx };
+      stats.target_ms = target_ms;
+      stats.over_target = over_target;
+      stats.published = since_target;
+
+      if (latencies.empty())
+        return stats;
+
+      sorted = latencies;
+      newest = published[(sequence - 1) % history];
+      oldest = published[latencies.size() < history ? 0 : sequence % history];
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0;
+    for (auto ms : sorted)
+      sum += ms;
+
+    stats.count = sorted.size();
+    stats.mean_ms = sum / sorted.size();
+    stats.p95_ms = sorted[(sorted.size() - 1) * 95 / 100];
+    stats.max_ms = sorted.back();
+
+    double span = std::chrono::duration<double>(newest - oldest).count();
+    if (span > 0)
+      stats.rate_hz = (sorted.size() - 1) / span;
+
+    return stats;
+  }
+
+  MeasurementStream &
+  measurement_stream()
+  {
+    static MeasurementStream stream;
+
+    return stream;
+  }
+
+} // namespace farsight
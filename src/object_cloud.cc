@@ -0,0 +1,56 @@
+#include "object_cloud.h"
+
+#include "disjoint_set.h"
+
+namespace farsight {
+
+  PointCloud
+  object_cloud(const DepthRays &rays,
+               const float *depth,
+               size_t x,
+               size_t y,
+               size_t w,
+               size_t h,
+               const RigidTransform &world,
+               const ObjectCloudParams &params,
+               DisjointSet &clusters,
+               WorkerPool *pool,
+               std::pmr::memory_resource *resource,
+               size_t *reclustered)
+  {
+    // tracked clusters live on the heap, they outlive the frame
+    if (!params.incremental)
+      clusters.reset(resource);
+
+    PointCloud cloud(resource);
+    rays.project(depth, x, y, w, h, cloud, INFINITY, pool);
+
+    auto transform = [&](size_t begin, size_t end) {
+      apply_transform(world, cloud, begin, end);
+    };
+    if (pool)
+      pool->parallel_for(0, cloud.size(), PointCloud::mask_bits, transform);
+    else
+      transform(0, cloud.size());
+
+    clip_floor(cloud, params.floor_level);
+    cloud.for_each_valid([&](size_t i) {
+      if (cloud.z[i] > params.max_z)
+        cloud.set_valid(i, false);
+    });
+
+    if (params.incremental)
+    {
+      auto count =
+        clusters.updateOrganizedPoints(cloud, w, params.tolerance);
+      if (reclustered)
+        *reclustered = count;
+    }
+    else
+      clusters.addOrganizedPoints(cloud, w, true, pool);
+
+    return voxel_downsample(
+      clusters.getValidPoints(resource), params.voxels, resource);
+  }
+
+} // namespace farsight
@@ -6,6 +6,7 @@
 #include <opencv2/core/types.hpp>
 #include <libfreenect2/frame_listener.hpp>
 #include "types.h"
+#include "cluster_stats.h"
 
 
 enum class objectType : unsigned int
@@ -27,7 +28,13 @@ struct object_t
         cv::Size(depth_width, depth_height), CV_8UC1); 
     libfreenect2::Frame depthFrame =
       libfreenect2::Frame(depth_width, depth_height, sizeof(float));
-    farsight::PointArray pointCloud;
+    // Double buffered, the dump writer may still hold the previous cloud
+    // while setConfig fills the spare one
+    std::shared_ptr<farsight::PointCloud> pointCloud =
+      std::make_shared<farsight::PointCloud>();
+    std::shared_ptr<farsight::PointCloud> spareCloud =
+      std::make_shared<farsight::PointCloud>();
+    farsight::ClusterStats stats;
     bool configured = false;
 };
 
@@ -41,6 +48,8 @@ struct cameraConfig
     farsight::Point3f camRot {0,0,0};
     cv::Mat img_base = cv::Mat::zeros(
         cv::Size(depth_width, depth_height), CV_8UC1);;
+    // img_base starts black, this tells a saved one apart
+    bool hasBase = false;
     libfreenect2::Frame base =
       libfreenect2::Frame(depth_width, depth_height, sizeof(float));
     objectArray objects;
@@ -0,0 +1,185 @@
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+
+#include <fmt/format.h>
+#include <opencv2/core/core.hpp>
+
+#include "offscreen_view.h"
+#include "scene.h"
+
+namespace farsight {
+
+  // Surfaceless platform needs no display server at all, plain default
+  // display is the fallback for drivers without it
+  static EGLDisplay
+  open_display()
+  {
+    auto get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+    if (get_platform_display)
+    {
+      EGLDisplay display = get_platform_display(
+        EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY)
+        return display;
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  OffscreenView::OffscreenView(int width, int height)
+    : width(width)
+    , height(height)
+  {
+    EGLint major, minor;
+
+    display = open_display();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+      error = "No EGL display";
+      display = nullptr;
+      return;
+    }
+
+    // Desktop GL compatibility context, the point renderer relies on the
+    // fixed function matrices
+    eglBindAPI(EGL_OPENGL_API);
+    context =
+      eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT)
+    {
+      error = fmt::format("No EGL context, error {:#x}", eglGetError());
+      context = nullptr;
+      return;
+    }
+
+    if (!make_current())
+      return;
+
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(
+      GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(
+      GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+      error = "Incomplete offscreen framebuffer";
+      glDeleteFramebuffers(1, &framebuffer);
+      framebuffer = 0;
+    }
+    else
+    {
+      // snapshots keep every point, time does not matter here
+      renderer = std::make_unique<PointRenderer>();
+      renderer->set_frame_target(0);
+    }
+
+    release();
+  }
+
+  OffscreenView::~OffscreenView()
+  {
+    if (!context)
+      return;
+
+    // GL objects have to go while their context is current
+    if (make_current())
+    {
+      renderer.reset();
+      glDeleteFramebuffers(1, &framebuffer);
+      glDeleteRenderbuffers(1, &color);
+      glDeleteRenderbuffers(1, &depth);
+      release();
+    }
+
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+  }
+
+  bool
+  OffscreenView::make_current()
+  {
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+      error = fmt::format("Cannot make EGL context current, error {:#x}",
+                          eglGetError());
+      return false;
+    }
+
+    return true;
+  }
+
+  void
+  OffscreenView::release()
+  {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+
+  cv::Mat
+  OffscreenView::render(const Context3D &scene,
+                        glm::vec3 eye,
+                        glm::vec3 center,
+                        glm::vec3 up)
+  {
+    if (!ready() || !make_current())
+      return {};
+
+    // both stay alive until the frame is read back
+    auto shots = scene.get_shots();
+    auto marks = scene.get_marks();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(70, double(width) / height, 1.0, 300.0);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    gluLookAt(eye.x,
+              eye.y,
+              eye.z,
+              center.x,
+              center.y,
+              center.z,
+              up.x,
+              up.y,
+              up.z);
+
+    draw_scene(*renderer, *shots, *marks);
+
+    // rows come bottom up, BGR matches the rest of the OpenCV code
+    cv::Mat image(height, width, CV_8UC3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+    cv::flip(image, image, 0);
+
+    release();
+
+    return image;
+  }
+
+} // namespace farsight
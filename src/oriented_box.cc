@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "oriented_box.h"
+
+namespace farsight {
+
+  using Point2 = glm::vec2;
+
+  static float
+  cross2(Point2 o, Point2 a, Point2 b)
+  {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+  }
+
+  static float
+  dot2(Point2 a, Point2 b)
+  {
+    return a.x * b.x + a.y * b.y;
+  }
+
+  // Eigenvectors of a symmetric matrix by cyclic Jacobi rotations, as
+  // columns of vec ordered by decreasing eigenvalue
+  static void
+  symmetric_eigen(const glm::mat3x3 &m, glm::vec3 vec[3])
+  {
+    double a[3][3], q[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+
+    for (int c = 0; c < 3; ++c)
+      for (int r = 0; r < 3; ++r)
+        a[r][c] = m[c][r];
+
+    for (int sweep = 0; sweep < 16; ++sweep)
+    {
+      double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+      if (off < 1e-30)
+        break;
+
+      for (int p = 0; p < 2; ++p)
+      {
+        for (int r = p + 1; r < 3; ++r)
+        {
+          if (a[p][r] == 0)
+            continue;
+
+          double theta = (a[r][r] - a[p][p]) / (2 * a[p][r]);
+          double t = (theta >= 0 ? 1 : -1) /
+                     (std::abs(theta) + std::sqrt(theta * theta + 1));
+          double c = 1 / std::sqrt(t * t + 1), s = t * c;
+
+          for (int k = 0; k < 3; ++k)
+          {
+            double akp = a[k][p], akr = a[k][r];
+            a[k][p] = c * akp - s * akr;
+            a[k][r] = s * akp + c * akr;
+          }
+          for (int k = 0; k < 3; ++k)
+          {
+            double apk = a[p][k], ark = a[r][k];
+            a[p][k] = c * apk - s * ark;
+            a[r][k] = s * apk + c * ark;
+          }
+          for (int k = 0; k < 3; ++k)
+          {
+            double qkp = q[k][p], qkr = q[k][r];
+            q[k][p] = c * qkp - s * qkr;
+            q[k][r] = s * qkp + c * qkr;
+          }
+        }
+      }
+    }
+
+    int order[3] = { 0, 1, 2 };
+    std::sort(order, order + 3, [&](int x, int y) {
+      return a[x][x] > a[y][y];
+    });
+
+    for (int i = 0; i < 3; ++i)
+      vec[i] = { float(q[0][order[i]]),
+                 float(q[1][order[i]]),
+                 float(q[2][order[i]]) };
+  }
+
+  // Diamond angle in [0, 4), monotonic in the real angle but without trig
+  static size_t
+  sector_of(float s, float t)
+  {
+    float sum = std::abs(s) + std::abs(t);
+    if (sum == 0)
+      return 0;
+
+    float d;
+    if (t >= 0)
+      d = s >= 0 ? t / sum : 1 - s / sum;
+    else
+      d = s < 0 ? 2 - t / sum : 3 + s / sum;
+
+    return std::min(size_t(d * (BoxMeasurer::sectors / 4)),
+                    BoxMeasurer::sectors - 1);
+  }
+
+  // Andrew's monotone chain, counter clockwise without collinear points
+  static std::vector<Point2>
+  convex_hull(std::vector<Point2> p)
+  {
+    std::sort(p.begin(), p.end(), [](Point2 a, Point2 b) {
+      return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+
+    if (p.size() < 3)
+      return p;
+
+    std::vector<Point2> hull(2 * p.size());
+    size_t k = 0;
+
+    for (size_t i = 0; i < p.size(); ++i)
+    {
+      while (k >= 2 && cross2(hull[k - 2], hull[k - 1], p[i]) <= 0)
+        k--;
+      hull[k++] = p[i];
+    }
+
+    for (size_t i = p.size() - 1, lower = k + 1; i > 0; --i)
+    {
+      while (k >= lower && cross2(hull[k - 2], hull[k - 1], p[i - 1]) <= 0)
+        k--;
+      hull[k++] = p[i - 1];
+    }
+
+    hull.resize(k - 1);
+    return hull;
+  }
+
+  struct FootprintRect
+  {
+    Point2 center{ 0, 0 };
+    Point2 axis{ 1, 0 };
+    float length = 0, width = 0;
+  };
+
+  // Rotating calipers, one side of the minimal rectangle lies on a hull
+  // edge. Three calipers walk the hull once: furthest point across the
+  // edge and both extremes along it.
+  static FootprintRect
+  min_area_rect(const std::vector<Point2> &h)
+  {
+    const size_t m = h.size();
+    FootprintRect best;
+
+    if (m == 0)
+      return best;
+
+    if (m < 3)
+    {
+      Point2 d = h.back() - h.front();
+      float len = std::sqrt(dot2(d, d));
+
+      best.center = (h.front() + h.back()) * 0.5f;
+      best.length = len;
+      if (len > 0)
+        best.axis = d / len;
+      return best;
+    }
+
+    auto at = [&](size_t i) { return h[i % m]; };
+    float best_area = INFINITY;
+    size_t far = 1, front = 1, back = 1;
+
+    for (size_t i = 0; i < m; ++i)
+    {
+      Point2 d = at(i + 1) - h[i];
+      Point2 e = d / std::sqrt(dot2(d, d));
+      Point2 across{ -e.y, e.x };
+
+      auto along = [&](size_t p) { return dot2(at(p), e); };
+      auto height = [&](size_t p) { return dot2(at(p) - h[i], across); };
+
+      if (i == 0)
+        front = 1;
+      for (size_t n = 0; n < m && along(front + 1) > along(front); ++n)
+        front++;
+
+      if (i == 0)
+        far = front;
+      for (size_t n = 0; n < m && height(far + 1) > height(far); ++n)
+        far++;
+
+      if (i == 0)
+        back = far;
+      for (size_t n = 0; n < m && along(back + 1) < along(back); ++n)
+        back++;
+
+      float length = along(front) - along(back);
+      float width = height(far);
+
+      if (length * width < best_area)
+      {
+        best_area = length * width;
+        best.axis = e;
+        best.length = length;
+        best.width = width;
+        best.center = e * ((along(front) + along(back)) / 2) +
+                      across * (dot2(h[i], across) + width / 2);
+      }
+    }
+
+    // longer side first
+    if (best.width > best.length)
+    {
+      std::swap(best.length, best.width);
+      best.axis = { -best.axis.y, best.axis.x };
+    }
+
+    return best;
+  }
+
+  BoxMeasurer::BoxMeasurer(const ClusterStats &stats, glm::vec3 up)
+    : outline(sectors)
+  {
+    auto c = stats.centroid();
+    origin = { c.x, c.y, c.z };
+
+    glm::vec3 eigen[3];
+    symmetric_eigen(stats.covariance(), eigen);
+
+    if (glm::dot(up, up) > 0)
+    {
+      n = up / std::sqrt(glm::dot(up, up));
+
+      // principal axis of the covariance restricted to the floor plane
+      glm::vec3 a = std::abs(n.x) < 0.9f ? glm::vec3{ 1, 0, 0 }
+                                         : glm::vec3{ 0, 1, 0 };
+      a = glm::normalize(a - n * glm::dot(a, n));
+      glm::vec3 b = glm::cross(n, a);
+
+      auto cov = stats.covariance();
+      float aa = glm::dot(a, cov * a), bb = glm::dot(b, cov * b);
+      float ab = glm::dot(a, cov * b);
+      float phi = 0.5f * std::atan2(2 * ab, aa - bb);
+
+      u = a * std::cos(phi) + b * std::sin(phi);
+    }
+    else
+    {
+      u = eigen[0];
+      n = eigen[2];
+    }
+
+    v = glm::cross(n, u);
+  }
+
+  void
+  BoxMeasurer::add(const PointCloud &cloud)
+  {
+    cloud.for_each_valid([&](size_t i) {
+      glm::vec3 d{ cloud.x[i] - origin.x,
+                   cloud.y[i] - origin.y,
+                   cloud.z[i] - origin.z };
+
+      float s = glm::dot(d, u), t = glm::dot(d, v), h = glm::dot(d, n);
+
+      low = std::min(low, h);
+      high = std::max(high, h);
+
+      auto &sector = outline[sector_of(s, t)];
+      float radius_sq = s * s + t * t;
+      if (radius_sq > sector.radius_sq)
+      {
+        sector.radius_sq = radius_sq;
+        sector.s = s;
+        sector.t = t;
+      }
+      sector.top = std::max(sector.top, h);
+    });
+
+    count += cloud.count_valid();
+  }
+
+  OrientedBox
+  BoxMeasurer::result() const
+  {
+    OrientedBox box;
+    box.count = count;
+
+    if (!count)
+      return box;
+
+    std::vector<Point2> points;
+    points.reserve(sectors);
+    for (const auto &sector : outline)
+    {
+      if (sector.radius_sq >= 0)
+        points.push_back({ sector.s, sector.t });
+    }
+
+    auto rect = min_area_rect(convex_hull(points));
+    Point2 side{ -rect.axis.y, rect.axis.x };
+
+    auto c = origin + u * rect.center.x + v * rect.center.y +
+             n * ((low + high) / 2);
+    box.center = { c.x, c.y, c.z };
+    box.axes[0] = u * rect.axis.x + v * rect.axis.y;
+    box.axes[1] = u * side.x + v * side.y;
+    box.axes[2] = n;
+    box.extents = { rect.length, rect.width, high - low };
+
+    // every outline point belongs to the nearer of the footprint faces,
+    // the highest point of every sector to the top face
+    double sum[3] = {};
+    size_t on_face[3] = {};
+
+    for (const auto &sector : outline)
+    {
+      if (sector.radius_sq < 0)
+        continue;
+
+      Point2 q = Point2{ sector.s, sector.t } - rect.center;
+      float da = rect.length / 2 - std::abs(dot2(q, rect.axis));
+      float db = rect.width / 2 - std::abs(dot2(q, side));
+      int face = da <= db ? 0 : 1;
+
+      sum[face] += double(std::min(da, db)) * std::min(da, db);
+      on_face[face]++;
+
+      sum[2] += double(high - sector.top) * (high - sector.top);
+      on_face[2]++;
+    }
+
+    for (int a = 0; a < 3; ++a)
+      box.residuals[a] = on_face[a] ? std::sqrt(sum[a] / on_face[a]) : 0;
+
+    return box;
+  }
+
+} // namespace farsight
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <string>
+
+#include <fmt/format.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "point_renderer.h"
+
+namespace farsight {
+
+  // GLSL 1.20 reads the fixed function matrices and vertex arrays, so the
+  // shader runs in any compatibility context including Mesa llvmpipe.
+  // Same pose and floor test as CameraShot::world_points, clipped points
+  // are moved behind the far plane since vertex shaders cannot discard.
+  static const char *pose_vertex_shader = R"(
+    #version 120
+
+    uniform mat3 pose_rot;
+    uniform vec3 pose_t;
+    uniform float floor_y;
+
+    void
+    main()
+    {
+      vec3 p = pose_rot * gl_Vertex.xyz + pose_t;
+
+      if (p.y <= floor_y)
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+      else
+        gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);
+
+      gl_FrontColor = gl_Color;
+    }
+  )";
+
+  // Points per pixel of the projected bounding sphere worth drawing, the
+  // sphere overestimates the footprint of surfaces seen by a camera
+  constexpr static double max_density = 2.0;
+
+  // Failures are kept in log, the renderer never writes to the console
+  static GLuint
+  compile_shader(GLenum type, const char *source, std::string &log)
+  {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok)
+    {
+      char info[1024] = {};
+      glGetShaderInfoLog(shader, sizeof(info), nullptr, info);
+      log += fmt::format("Point shader compilation failed: {}", info);
+    }
+
+    return shader;
+  }
+
+  PointRenderer::~PointRenderer()
+  {
+    for (auto &b : buffers)
+      glDeleteBuffers(1, &b.id);
+
+    if (program)
+      glDeleteProgram(program);
+  }
+
+  void
+  PointRenderer::build_program()
+  {
+    GLuint vs =
+      compile_shader(GL_VERTEX_SHADER, pose_vertex_shader, program_log);
+
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+      char info[1024] = {};
+      glGetProgramInfoLog(program, sizeof(info), nullptr, info);
+      program_log += fmt::format("Point shader linking failed: {}", info);
+    }
+
+    pose_rot_loc = glGetUniformLocation(program, "pose_rot");
+    pose_t_loc = glGetUniformLocation(program, "pose_t");
+    floor_y_loc = glGetUniformLocation(program, "floor_y");
+  }
+
+  void
+  PointRenderer::upload(Buffer &buffer, const PointCloud &points)
+  {
+    constexpr size_t coarsest = size_t(1) << (lod_levels - 1);
+    const size_t n = points.count_valid();
+
+    // level l adds every (coarsest >> l)-th point, offset is where its
+    // points start in the buffer
+    size_t offset[lod_levels];
+    for (size_t l = 0; l < lod_levels; ++l)
+    {
+      size_t stride = coarsest >> l;
+
+      offset[l] = l ? buffer.count[l - 1] : 0;
+      buffer.count[l] = (n + stride - 1) / stride;
+    }
+
+    glm::vec3 lo{ INFINITY, INFINITY, INFINITY };
+    glm::vec3 hi{ -INFINITY, -INFINITY, -INFINITY };
+
+    staging.resize(n);
+
+    size_t j = 0;
+    points.for_each_valid([&](size_t i) {
+      // trailing zeros of j tell the coarsest level it belongs to
+      size_t level = lod_levels - 1;
+      if (j % coarsest == 0)
+        level = 0;
+      else
+        level -= __builtin_ctzll(j);
+
+      staging[offset[level]++] = {
+        points.x[i], points.y[i], points.z[i], points.color[i]
+      };
+      ++j;
+
+      lo = { std::min(lo.x, points.x[i]),
+             std::min(lo.y, points.y[i]),
+             std::min(lo.z, points.z[i]) };
+      hi = { std::max(hi.x, points.x[i]),
+             std::max(hi.y, points.y[i]),
+             std::max(hi.z, points.z[i]) };
+    });
+
+    if (n)
+    {
+      auto extent = hi - lo;
+
+      buffer.center = (lo + hi) * 0.5f;
+      buffer.radius = 0.5f * std::sqrt(glm::dot(extent, extent));
+    }
+
+    if (!buffer.id)
+      glGenBuffers(1, &buffer.id);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.id);
+
+    // storage only grows, smaller clouds are written over its front
+    auto bytes = staging.size() * sizeof(Vertex);
+    if (bytes > buffer.capacity)
+    {
+      glBufferData(GL_ARRAY_BUFFER, bytes, staging.data(), GL_DYNAMIC_DRAW);
+      buffer.capacity = bytes;
+    }
+    else if (bytes)
+      glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, staging.data());
+  }
+
+  GLsizei
+  PointRenderer::pick_count(const Buffer &buffer, const CameraShot &shot) const
+  {
+    const GLsizei all = buffer.count[lod_levels - 1];
+
+    if (frame_target_ms <= 0)
+      return all;
+
+    glm::vec3 center = buffer.center;
+    apply_transform(pose_transform(shot.tvec, shot.rvec), center);
+
+    auto to_eye = center - eye;
+    float distance = std::sqrt(glm::dot(to_eye, to_eye));
+
+    // the eye is inside the cloud, any level may be close
+    if (distance <= buffer.radius)
+      return all;
+
+    float radius_px = buffer.radius * pixels_per_unit / distance;
+    double wanted = max_density * M_PI * radius_px * radius_px * detail;
+
+    for (size_t l = 0; l < lod_levels; ++l)
+    {
+      if (buffer.count[l] >= wanted)
+        return buffer.count[l];
+    }
+
+    return all;
+  }
+
+  void
+  PointRenderer::report_frame(double frame_ms)
+  {
+    constexpr double min_detail = 1.0 / (1 << (lod_levels - 1));
+
+    if (frame_target_ms <= 0)
+      return;
+
+    // slack between half and full target keeps the level from flickering
+    if (frame_ms > frame_target_ms)
+      detail = std::max(detail * 0.8, min_detail);
+    else if (frame_ms < frame_target_ms / 2)
+      detail = std::min(detail * 1.25, 1.0);
+  }
+
+  void
+  PointRenderer::draw(const Context3D::Shots &shots)
+  {
+    if (!program)
+      build_program();
+
+    // eye is -R^T t of the column major modelview matrix
+    GLfloat mv[16], proj[16];
+    GLint viewport[4];
+    glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+    glGetFloatv(GL_PROJECTION_MATRIX, proj);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    eye = { -(mv[0] * mv[12] + mv[1] * mv[13] + mv[2] * mv[14]),
+            -(mv[4] * mv[12] + mv[5] * mv[13] + mv[6] * mv[14]),
+            -(mv[8] * mv[12] + mv[9] * mv[13] + mv[10] * mv[14]) };
+    pixels_per_unit = proj[5] * viewport[3] / 2.0f;
+
+    for (size_t i = shots.size(); i < buffers.size(); ++i)
+      glDeleteBuffers(1, &buffers[i].id);
+    buffers.resize(shots.size());
+
+    glUseProgram(program);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    point_count = 0;
+
+    for (size_t i = 0; i < shots.size(); ++i)
+    {
+      auto &b = buffers[i];
+      const auto &shot = *shots[i];
+
+      // pose and floor changes republish the shot with the same points,
+      // those only update the uniforms below
+      if (b.points != shot.points)
+      {
+        auto start = std::chrono::steady_clock::now();
+
+        upload(b, *shot.points);
+        b.points = shot.points;
+
+        upload_ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      }
+
+      auto count = pick_count(b, shot);
+      if (!count)
+        continue;
+
+      auto pose = pose_transform(shot.tvec, shot.rvec);
+      glm::mat3x3 rot(pose[0], pose[1], pose[2]);
+
+      glUniformMatrix3fv(pose_rot_loc, 1, GL_FALSE, glm::value_ptr(rot));
+      glUniform3fv(pose_t_loc, 1, glm::value_ptr(pose[3]));
+      glUniform1f(floor_y_loc, FLOOR_BASE_Y + shot.floor_level);
+
+      glBindBuffer(GL_ARRAY_BUFFER, b.id);
+      glVertexPointer(3,
+                      GL_FLOAT,
+                      sizeof(Vertex),
+                      reinterpret_cast<void *>(offsetof(Vertex, x)));
+      // ColorType keeps r, g, b in the first three bytes of the word
+      glColorPointer(3,
+                     GL_UNSIGNED_BYTE,
+                     sizeof(Vertex),
+                     reinterpret_cast<void *>(offsetof(Vertex, color)));
+      glDrawArrays(GL_POINTS, 0, count);
+
+      point_count += count;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glUseProgram(0);
+  }
+
+} // namespace farsight
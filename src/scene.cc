@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <iterator>
+
+#include <GL/gl.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "scene.h"
+
+using glm::value_ptr;
+using glm::vec3;
+
+namespace farsight {
+
+  static void
+  Axes(void)
+  {
+    vec3 x_min = { -50.0, 0.0, 0.0 };
+    vec3 x_max = { 50.0, 0.0, 0.0 };
+
+    vec3 y_min = { 0.0, -50.0, 0.0 };
+    vec3 y_max = { 0.0, 50.0, 0.0 };
+
+    vec3 z_min = { 0.0, 0.0, -50.0 };
+    vec3 z_max = { 0.0, 0.0, 50.0 };
+
+    glColor3f(1.0f, 0.0f, 0.0f);
+    glBegin(GL_LINES);
+
+    glVertex3fv(value_ptr(x_min));
+    glVertex3fv(value_ptr(x_max));
+
+    glEnd();
+
+    glColor3f(0.0f, 0.5f, 0.0f);
+    glBegin(GL_LINES);
+    glVertex3fv(value_ptr(y_min));
+    glVertex3f(0, 0, 0);
+    glEnd();
+
+    glColor3f(0.0f, 1.0f, 0.0f);
+    glBegin(GL_LINES);
+    glVertex3fv(value_ptr(y_max));
+    glVertex3f(0, 0, 0);
+    glEnd();
+
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBegin(GL_LINES);
+
+    glVertex3fv(value_ptr(z_min));
+    glVertex3fv(value_ptr(z_max));
+
+    glEnd();
+  }
+
+  static void
+  drawmarks(const RectArray &marks)
+  {
+    using VertType = decltype(marks[0].verts);
+
+    for (auto &m : marks)
+    {
+      glBegin(GL_LINE_LOOP);
+
+      VertType verts;
+      std::copy(std::begin(m.verts), std::end(m.verts), std::begin(verts));
+
+      auto color = m.color;
+
+      for (auto &v : verts) {
+        glColor3ub(color.r, color.g, color.b);
+        glVertex3f(v.x, v.y, v.z);
+      }
+
+      glEnd();
+    }
+  }
+
+  void
+  draw_scene(PointRenderer &renderer,
+             const Context3D::Shots &shots,
+             const RectArray &marks)
+  {
+    Axes();
+    renderer.draw(shots);
+    drawmarks(marks);
+  }
+
+} // namespace farsight
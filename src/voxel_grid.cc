@@ -0,0 +1,72 @@
+#include <cmath>
+#include <unordered_map>
+
+#include "voxel_grid.h"
+
+namespace farsight {
+
+  PointCloud
+  voxel_downsample(const PointCloud &cloud,
+                   const VoxelGridParams &params,
+                   std::pmr::memory_resource *resource)
+  {
+    PointCloud ret(resource);
+
+    if (params.leaf_size <= 0.0f)
+    {
+      ret = cloud;
+      ret.compact();
+      return ret;
+    }
+
+    const float inv_leaf = 1.0f / params.leaf_size;
+    const bool centroid = params.select == VoxelSelect::CENTROID;
+
+    std::pmr::vector<uint32_t> count(resource);
+    std::pmr::unordered_map<uint64_t, uint32_t> voxels(resource);
+
+    ret.width = cloud.width;
+    voxels.reserve(cloud.size());
+
+    cloud.for_each_valid([&](size_t i) {
+      auto key = voxel_key(cloud.x[i], cloud.y[i], cloud.z[i], inv_leaf);
+      auto [it, inserted] = voxels.try_emplace(key, ret.size());
+
+      if (inserted)
+      {
+        ColorType color;
+        color.packed = cloud.color[i];
+
+        ret.push_back(
+          { cloud.x[i], cloud.y[i], cloud.z[i] }, color, cloud.index[i]);
+        count.push_back(1);
+        return;
+      }
+
+      if (centroid)
+      {
+        auto slot = it->second;
+
+        ret.x[slot] += cloud.x[i];
+        ret.y[slot] += cloud.y[i];
+        ret.z[slot] += cloud.z[i];
+        count[slot] += 1;
+      }
+    });
+
+    if (centroid)
+    {
+      for (size_t i = 0; i < ret.size(); ++i)
+      {
+        const float inv = 1.0f / count[i];
+
+        ret.x[i] *= inv;
+        ret.y[i] *= inv;
+        ret.z[i] *= inv;
+      }
+    }
+
+    return ret;
+  }
+
+} // namespace farsight
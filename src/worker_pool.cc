@@ -0,0 +1,140 @@
+#include <algorithm>
+
+#include "worker_pool.h"
+
+namespace farsight {
+
+  namespace {
+
+    // Set while the thread works on bands of any pool
+    thread_local bool in_band = false;
+
+  } // namespace
+
+  WorkerPool::WorkerPool(size_t workers)
+  {
+    threads.reserve(workers);
+
+    for (size_t i = 0; i < workers; ++i)
+      threads.emplace_back(&WorkerPool::worker, this);
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    {
+      std::unique_lock lck{ mtx };
+      stop = true;
+    }
+
+    wake.notify_all();
+
+    for (auto &t : threads)
+      t.join();
+  }
+
+  void
+  WorkerPool::work(BandFn fn, void *ctx)
+  {
+    size_t band;
+    in_band = true;
+
+    while ((band = next_band.fetch_add(1)) < band_count)
+    {
+      auto b = std::max(job_begin, job_base + band * band_size);
+      auto e = std::min(job_end, job_base + (band + 1) * band_size);
+
+      fn(ctx, b, e);
+
+      if (pending.fetch_sub(1) == 1)
+      {
+        std::unique_lock lck{ mtx };
+        done.notify_all();
+      }
+    }
+    in_band = false;
+  }
+
+  void
+  WorkerPool::worker()
+  {
+    size_t seen = 0;
+
+    for (;;)
+    {
+      std::unique_lock lck{ mtx };
+      wake.wait(lck, [&] { return stop || generation != seen; });
+
+      if (stop)
+        return;
+
+      seen = generation;
+      ++active;
+
+      auto fn = job_fn;
+      auto ctx = job_ctx;
+      lck.unlock();
+
+      work(fn, ctx);
+
+      lck.lock();
+      if (--active == 0)
+        done.notify_all();
+    }
+  }
+
+  void
+  WorkerPool::run(size_t begin, size_t end, size_t grain, BandFn fn, void *ctx)
+  {
+    if (begin >= end)
+      return;
+
+    grain = std::max<size_t>(grain, 1);
+
+    const auto base = begin - begin % grain;
+    const auto grains = (end - base + grain - 1) / grain;
+    const auto bands = std::min(grains, get_concurrency());
+
+    // a nested call waiting for workers busy with the outer job would
+    // never return
+    if (bands <= 1 || in_band)
+    {
+      fn(ctx, begin, end);
+      return;
+    }
+
+    std::unique_lock job{ caller };
+    std::unique_lock lck{ mtx };
+
+    // Late workers of previous job may still hold its description
+    done.wait(lck, [&] { return active == 0; });
+
+    job_fn = fn;
+    job_ctx = ctx;
+    job_begin = begin;
+    job_end = end;
+    job_base = base;
+    band_size = (grains + bands - 1) / bands * grain;
+    band_count = (end - base + band_size - 1) / band_size;
+    next_band = 0;
+    pending = band_count;
+    ++generation;
+
+    lck.unlock();
+    wake.notify_all();
+
+    work(fn, ctx);
+
+    lck.lock();
+    done.wait(lck, [&] { return pending == 0; });
+  }
+
+  WorkerPool &
+  worker_pool()
+  {
+    static WorkerPool pool(
+      std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    return pool;
+  }
+
+} // namespace farsight